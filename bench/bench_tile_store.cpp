@@ -0,0 +1,151 @@
+//  SuperTux Tile Manager - A utility for SuperTux to manage tiles
+//  Copyright (C) 2021 Semphris <semphris@protonmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Compares TileStore with the vector of Tile it replaced, on a group
+// of 10,000 tiles laid out 100 wide: bytes held, and the best of 200
+// runs of a few scans.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "tile.hpp"
+
+namespace {
+
+const unsigned int WIDTH = 100;
+const unsigned int TILES = 10000;
+const int RUNS = 200;
+
+/** The tile as it was stored before TileStore */
+struct OldTile
+{
+  OldTile(uint32_t id_, const Rect& srcrect_) :
+    id(id_), srcrect(srcrect_),
+    mask_up(1), mask_left(1), mask_down(1), mask_right(1), non_solid(false),
+    in_up(), ex_up(), in_left(), ex_left(), in_down(), ex_down(), in_right(), ex_right()
+  {}
+
+  uint32_t id;
+  Rect srcrect;
+  short mask_up;
+  short mask_left;
+  short mask_down;
+  short mask_right;
+  bool non_solid;
+  std::vector<OldTile*> in_up;
+  std::vector<OldTile*> ex_up;
+  std::vector<OldTile*> in_left;
+  std::vector<OldTile*> ex_left;
+  std::vector<OldTile*> in_down;
+  std::vector<OldTile*> ex_down;
+  std::vector<OldTile*> in_right;
+  std::vector<OldTile*> ex_right;
+};
+
+// Keeps the compiler from dropping the scans
+volatile double g_sink;
+
+template<typename Func>
+double best_us(Func func)
+{
+  double best = 1e30;
+  for (int run = 0; run < RUNS; ++run)
+  {
+    const auto start = std::chrono::steady_clock::now();
+    g_sink = func();
+    const auto end = std::chrono::steady_clock::now();
+    best = std::min(best, std::chrono::duration<double, std::micro>(end - start).count());
+  }
+  return best;
+}
+
+} // namespace
+
+int main()
+{
+  std::vector<uint32_t> ids(TILES);
+  for (uint32_t i = 0; i < TILES; ++i)
+    ids[i] = i + 1;
+
+  std::vector<OldTile> old_tiles;
+  old_tiles.reserve(TILES);
+  for (uint32_t i = 0; i < TILES; ++i)
+    old_tiles.emplace_back(ids[i], Rect(Vector(i % WIDTH, i / WIDTH) * 32.f, Size(32.f, 32.f)));
+
+  const TileStore store(Vector(0.f, 0.f), WIDTH, ids);
+
+  // Ids spread over the group, looked up by linear search as the scenes do
+  std::vector<uint32_t> wanted;
+  for (uint32_t i = 0; i < 50; ++i)
+    wanted.push_back(1 + i * (TILES / 50));
+
+  const size_t old_bytes = old_tiles.capacity() * sizeof(OldTile);
+  const size_t store_bytes = store.get_memory_usage();
+  std::printf("%-16s %10s   %10s\n", "", "old", "store");
+  std::printf("%-16s %10.1f B %10.1f B  per tile\n", "footprint",
+              static_cast<double>(old_bytes) / TILES, static_cast<double>(store_bytes) / TILES);
+
+  const double old_sum = best_us([&] {
+    double sum = 0.0;
+    for (const auto& tile : old_tiles)
+      sum += tile.id;
+    return sum;
+  });
+  const double store_sum = best_us([&] {
+    double sum = 0.0;
+    for (const auto id : store.get_ids())
+      sum += id;
+    return sum;
+  });
+  std::printf("%-16s %10.1f us %10.1f us\n", "sum of ids", old_sum, store_sum);
+
+  const double old_find = best_us([&] {
+    double found = 0.0;
+    for (const auto id : wanted)
+      found += std::find_if(old_tiles.begin(), old_tiles.end(),
+                            [id](const OldTile& tile) { return tile.id == id; }) - old_tiles.begin();
+    return found;
+  });
+  const double store_find = best_us([&] {
+    double found = 0.0;
+    for (const auto id : wanted)
+      found += std::find(store.get_ids().begin(), store.get_ids().end(), id) - store.get_ids().begin();
+    return found;
+  });
+  std::printf("%-16s %10.1f us %10.1f us\n", "50 id lookups", old_find, store_find);
+
+  const double old_rects = best_us([&] {
+    double sum = 0.0;
+    for (const auto& tile : old_tiles)
+      sum += tile.srcrect.x1 + tile.srcrect.y1;
+    return sum;
+  });
+  const double store_rects = best_us([&] {
+    double sum = 0.0;
+    for (size_t i = 0; i < store.size(); ++i)
+    {
+      const Rect rect = store.get_srcrect(i);
+      sum += rect.x1 + rect.y1;
+    }
+    return sum;
+  });
+  std::printf("%-16s %10.1f us %10.1f us\n", "rect scan", old_rects, store_rects);
+
+  return 0;
+}
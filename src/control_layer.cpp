@@ -0,0 +1,72 @@
+//  SuperTux Tile Manager - A utility for SuperTux to manage tiles
+//  Copyright (C) 2021 Semphris <semphris@protonmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "control_layer.hpp"
+
+#include "util/color.hpp"
+#include "util/rect.hpp"
+#include "video/drawing_context.hpp"
+#include "video/renderer.hpp"
+#include "video/texture.hpp"
+#include "video/window.hpp"
+
+size_t ControlLayer::s_allocations = 0;
+size_t ControlLayer::s_renders = 0;
+size_t ControlLayer::s_allocations_avoided = 0;
+
+ControlLayer::ControlLayer() :
+  m_texture(),
+  m_size(),
+  m_dirty(true)
+{
+}
+
+Texture&
+ControlLayer::get(Window& window, const std::function<void(DrawingContext&)>& draw)
+{
+  return get(window, window.get_size(), draw);
+}
+
+Texture&
+ControlLayer::get(Window& window, const Size& size, const std::function<void(DrawingContext&)>& draw)
+{
+  if (!m_texture || size.w != m_size.w || size.h != m_size.h)
+  {
+    m_texture = window.create_texture(size);
+    m_size = size;
+    m_dirty = true;
+    s_allocations++;
+  }
+  else
+  {
+    s_allocations_avoided++;
+  }
+
+  if (m_dirty)
+  {
+    DrawingContext dc(window.get_renderer());
+
+    // The texture is reused, so clear what the last render left behind
+    dc.draw_filled_rect(Rect(size), Color(0.f, 0.f, 0.f, 0.f), Renderer::Blend::NONE, 0);
+    draw(dc);
+    dc.render(m_texture.get());
+
+    m_dirty = false;
+    s_renders++;
+  }
+
+  return *m_texture;
+}
@@ -0,0 +1,66 @@
+//  SuperTux Tile Manager - A utility for SuperTux to manage tiles
+//  Copyright (C) 2021 Semphris <semphris@protonmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _HEADER_STTILEMAN_CONTROL_LAYER_HPP
+#define _HEADER_STTILEMAN_CONTROL_LAYER_HPP
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+
+#include "util/size.hpp"
+
+class DrawingContext;
+class Texture;
+class Window;
+
+/** A texture that a scene draws its controls, or anything else that
+    rarely changes, into. It is only drawn again after invalidate() or
+    when its size changed, and only reallocated in the latter case.
+    Main thread only. */
+class ControlLayer final
+{
+public:
+  ControlLayer();
+
+  void invalidate() { m_dirty = true; }
+
+  /** Returns the layer, first calling draw to fill it if it is stale */
+  Texture& get(Window& window, const std::function<void(DrawingContext&)>& draw);
+  /** Same, for a layer that doesn't cover the whole window */
+  Texture& get(Window& window, const Size& size, const std::function<void(DrawingContext&)>& draw);
+
+  /** Counters across all layers, to see how well caching works */
+  static size_t get_allocations() { return s_allocations; }
+  static size_t get_renders() { return s_renders; }
+  static size_t get_allocations_avoided() { return s_allocations_avoided; }
+
+private:
+  static size_t s_allocations;
+  static size_t s_renders;
+  static size_t s_allocations_avoided;
+
+private:
+  std::unique_ptr<Texture> m_texture;
+  Size m_size;
+  bool m_dirty;
+
+private:
+  ControlLayer(const ControlLayer&) = delete;
+  ControlLayer& operator=(const ControlLayer&) = delete;
+};
+
+#endif
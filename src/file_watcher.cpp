@@ -0,0 +1,129 @@
+//  SuperTux Tile Manager - A utility for SuperTux to manage tiles
+//  Copyright (C) 2021 Semphris <semphris@protonmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "file_watcher.hpp"
+
+#include <filesystem>
+
+#include "util/log.hpp"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+FileWatcher::FileWatcher() :
+  m_fd(-1),
+  m_dirs(),
+  m_dir_watches(),
+  m_files()
+{
+#ifdef __linux__
+  m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (m_fd < 0)
+    log_warn << "inotify unavailable, tilesets won't be reloaded automatically" << std::endl;
+#endif
+}
+
+FileWatcher::~FileWatcher()
+{
+#ifdef __linux__
+  if (m_fd >= 0)
+    close(m_fd);
+#endif
+}
+
+void
+FileWatcher::add(const std::string& filename)
+{
+  // Events name the entry in the watched directory, so only the
+  // directory is resolved; the file name is kept as given, even if it
+  // is a symlink.
+  std::error_code ec;
+  const fs::path path = fs::absolute(filename, ec);
+  if (ec)
+    return;
+
+  const fs::path parent = fs::weakly_canonical(path.parent_path(), ec);
+  if (ec || !m_files.insert((parent / path.filename()).string()).second)
+    return;
+
+#ifdef __linux__
+  const std::string dir = parent.string();
+  if (m_fd < 0 || m_dir_watches.count(dir))
+    return;
+
+  const int wd = inotify_add_watch(m_fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+  if (wd < 0)
+  {
+    log_warn << "Couldn't watch '" << dir << "' for changes" << std::endl;
+    return;
+  }
+
+  m_dirs[wd] = dir;
+  m_dir_watches[dir] = wd;
+#endif
+}
+
+void
+FileWatcher::clear()
+{
+#ifdef __linux__
+  for (const auto& dir : m_dirs)
+    inotify_rm_watch(m_fd, dir.first);
+#endif
+
+  m_dirs.clear();
+  m_dir_watches.clear();
+  m_files.clear();
+}
+
+std::vector<std::string>
+FileWatcher::poll()
+{
+  std::set<std::string> changed;
+
+#ifdef __linux__
+  if (m_fd < 0)
+    return {};
+
+  alignas(struct inotify_event) char buffer[4096];
+  for (;;)
+  {
+    const ssize_t len = read(m_fd, buffer, sizeof(buffer));
+    if (len <= 0)
+      break;
+
+    for (const char* ptr = buffer; ptr < buffer + len; )
+    {
+      const auto* event = reinterpret_cast<const struct inotify_event*>(ptr);
+      ptr += sizeof(struct inotify_event) + event->len;
+
+      auto dir = m_dirs.find(event->wd);
+      if (dir == m_dirs.end() || event->len == 0)
+        continue;
+
+      std::string file = (fs::path(dir->second) / event->name).string();
+      if (m_files.count(file))
+        changed.insert(std::move(file));
+    }
+  }
+#endif
+
+  return std::vector<std::string>(changed.begin(), changed.end());
+}
@@ -0,0 +1,52 @@
+//  SuperTux Tile Manager - A utility for SuperTux to manage tiles
+//  Copyright (C) 2021 Semphris <semphris@protonmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _HEADER_STTILEMAN_FILE_WATCHER_HPP
+#define _HEADER_STTILEMAN_FILE_WATCHER_HPP
+
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/** Reports changes to a set of files. Uses inotify on Linux and does
+    nothing on other platforms. The parent directories are watched
+    rather than the files themselves, so editors that save by writing a
+    new file and renaming it over the old one are noticed as well. */
+class FileWatcher final
+{
+public:
+  FileWatcher();
+  ~FileWatcher();
+
+  void add(const std::string& filename);
+  void clear();
+
+  /** Returns the files that changed since the last call, without blocking */
+  std::vector<std::string> poll();
+
+private:
+  int m_fd;
+  std::unordered_map<int, std::string> m_dirs;
+  std::unordered_map<std::string, int> m_dir_watches;
+  std::set<std::string> m_files;
+
+private:
+  FileWatcher(const FileWatcher&) = delete;
+  FileWatcher& operator=(const FileWatcher&) = delete;
+};
+
+#endif
@@ -0,0 +1,224 @@
+//  SuperTux Tile Manager - A utility for SuperTux to manage tiles
+//  Copyright (C) 2021 Semphris <semphris@protonmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "image.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef STTILEMAN_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "SDL.h"
+#include "SDL_image.h"
+
+#include "video/texture.hpp"
+#include "video/window.hpp"
+
+std::shared_ptr<Image>
+Image::from_file(const std::string& filename)
+{
+  SDL_Surface* loaded = IMG_Load(filename.c_str());
+  if (!loaded)
+  {
+    std::ostringstream msg;
+    msg << "Couldn't load image '" << filename << "': " << IMG_GetError();
+    throw std::runtime_error(msg.str());
+  }
+
+  SDL_Surface* converted = SDL_ConvertSurfaceFormat(loaded, SDL_PIXELFORMAT_RGBA32, 0);
+  SDL_FreeSurface(loaded);
+  if (!converted)
+  {
+    std::ostringstream msg;
+    msg << "Couldn't convert image '" << filename << "': " << SDL_GetError();
+    throw std::runtime_error(msg.str());
+  }
+
+  return std::make_shared<Image>(converted);
+}
+
+Size
+Image::read_size(const std::string& filename)
+{
+  std::ifstream in(filename, std::ios::binary);
+  if (!in.good())
+  {
+    std::ostringstream msg;
+    msg << "Couldn't load image '" << filename << "': file not found";
+    throw std::runtime_error(msg.str());
+  }
+
+  // PNG signature, then the IHDR chunk: length, type, width, height
+  static const unsigned char png_signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+  unsigned char header[24];
+  if (in.read(reinterpret_cast<char*>(header), sizeof(header)) &&
+      std::memcmp(header, png_signature, sizeof(png_signature)) == 0 &&
+      std::memcmp(header + 12, "IHDR", 4) == 0)
+  {
+    auto read_u32 = [](const unsigned char* data) {
+      return (uint32_t(data[0]) << 24) | (uint32_t(data[1]) << 16) | (uint32_t(data[2]) << 8) | uint32_t(data[3]);
+    };
+    return Size(static_cast<float>(read_u32(header + 16)), static_cast<float>(read_u32(header + 20)));
+  }
+
+  return from_file(filename)->get_size();
+}
+
+std::unique_ptr<Image>
+Image::create(int width, int height)
+{
+  SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_RGBA32);
+  if (!surface)
+  {
+    std::ostringstream msg;
+    msg << "Couldn't create " << width << "x" << height << " image: " << SDL_GetError();
+    throw std::runtime_error(msg.str());
+  }
+
+  std::memset(surface->pixels, 0, static_cast<size_t>(surface->pitch) * height);
+  return std::make_unique<Image>(surface);
+}
+
+Image::Image(SDL_Surface* surface) :
+  m_surface(surface)
+{
+}
+
+Image::~Image()
+{
+  SDL_FreeSurface(m_surface);
+}
+
+Size
+Image::get_size() const
+{
+  return Size(static_cast<float>(m_surface->w), static_cast<float>(m_surface->h));
+}
+
+int
+Image::get_width() const
+{
+  return m_surface->w;
+}
+
+int
+Image::get_height() const
+{
+  return m_surface->h;
+}
+
+int
+Image::get_pitch() const
+{
+  return m_surface->pitch;
+}
+
+const uint8_t*
+Image::get_pixels() const
+{
+  return static_cast<const uint8_t*>(m_surface->pixels);
+}
+
+uint8_t*
+Image::get_pixels()
+{
+  return static_cast<uint8_t*>(m_surface->pixels);
+}
+
+std::unique_ptr<Image>
+Image::downscaled() const
+{
+  const int width = std::max(1, get_width() / 2);
+  const int height = std::max(1, get_height() / 2);
+  auto result = create(width, height);
+
+  for (int y = 0; y < height; ++y)
+  {
+    // Odd sizes drop the last row or column
+    const int y0 = std::min(y * 2, get_height() - 1);
+    const int y1 = std::min(y * 2 + 1, get_height() - 1);
+    const uint8_t* rows[2] = { get_pixels() + y0 * get_pitch(), get_pixels() + y1 * get_pitch() };
+    uint8_t* out = result->get_pixels() + y * result->get_pitch();
+
+    for (int x = 0; x < width; ++x)
+    {
+      const int x0 = std::min(x * 2, get_width() - 1) * 4;
+      const int x1 = std::min(x * 2 + 1, get_width() - 1) * 4;
+      const uint8_t* px[4] = { rows[0] + x0, rows[0] + x1, rows[1] + x0, rows[1] + x1 };
+
+      unsigned int alpha = 0;
+      unsigned int color[3] = { 0, 0, 0 };
+      for (const auto* p : px)
+      {
+        alpha += p[3];
+        for (int c = 0; c < 3; ++c)
+          color[c] += p[c] * p[3];
+      }
+
+      for (int c = 0; c < 3; ++c)
+        out[x * 4 + c] = static_cast<uint8_t>(alpha ? (color[c] + alpha / 2) / alpha : 0);
+      out[x * 4 + 3] = static_cast<uint8_t>((alpha + 2) / 4);
+    }
+  }
+
+  return result;
+}
+
+std::unique_ptr<Image>
+Image::cropped(int x, int y, int width, int height) const
+{
+  auto result = create(width, height);
+  for (int row = 0; row < height; ++row)
+  {
+    std::memcpy(result->get_pixels() + row * result->get_pitch(),
+                get_pixels() + (y + row) * get_pitch() + x * 4,
+                static_cast<size_t>(width) * 4);
+  }
+  return result;
+}
+
+uint32_t
+Image::get_opaque_bits(const uint8_t* pixels)
+{
+#ifdef STTILEMAN_USE_SSE2
+  // Alpha is the top byte of each pixel, so an alpha of 128 or more is
+  // exactly the sign bit
+  uint32_t bits = 0;
+  for (int i = 0; i < 8; ++i)
+  {
+    const __m128i quad = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + i * 16));
+    bits |= static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(quad))) << (i * 4);
+  }
+  return bits;
+#else
+  uint32_t bits = 0;
+  for (int i = 0; i < 32; ++i)
+    if (pixels[i * 4 + 3] >= 128)
+      bits |= uint32_t(1) << i;
+  return bits;
+#endif
+}
+
+std::unique_ptr<Texture>
+Image::upload(Window& window) const
+{
+  return window.create_texture(m_surface);
+}
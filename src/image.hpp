@@ -0,0 +1,86 @@
+//  SuperTux Tile Manager - A utility for SuperTux to manage tiles
+//  Copyright (C) 2021 Semphris <semphris@protonmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _HEADER_STTILEMAN_IMAGE_HPP
+#define _HEADER_STTILEMAN_IMAGE_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "util/size.hpp"
+
+// SSE2 is part of every x86-64 target; elsewhere the scalar paths are used
+#if defined(__SSE2__) || defined(_M_X64)
+#define STTILEMAN_USE_SSE2
+#endif
+
+struct SDL_Surface;
+class Texture;
+class Window;
+
+/** CPU-side decoded image, always stored as tightly addressable RGBA32.
+    Decoding does not touch the renderer, so images can be loaded from
+    worker threads; only upload() must run on the main thread. */
+class Image final
+{
+public:
+  static std::shared_ptr<Image> from_file(const std::string& filename);
+
+  /** Reads only the dimensions of an image. PNGs are answered from their
+      header; other formats are decoded. */
+  static Size read_size(const std::string& filename);
+
+  /** Creates a fully transparent image */
+  static std::unique_ptr<Image> create(int width, int height);
+
+  /** Returns a bit per pixel of a run of 32 RGBA32 pixels, such as a
+      tile row or edge, set where the pixel is at least half opaque */
+  static uint32_t get_opaque_bits(const uint8_t* pixels);
+
+public:
+  Image(SDL_Surface* surface);
+  ~Image();
+
+  Size get_size() const;
+  int get_width() const;
+  int get_height() const;
+
+  /** Bytes per row; may be larger than 4 * width */
+  int get_pitch() const;
+  const uint8_t* get_pixels() const;
+  uint8_t* get_pixels();
+
+  /** Returns a copy at half the size, each pixel averaging a 2x2 block.
+      Colors are weighted by alpha so that transparent pixels don't
+      darken the edges of what they surround. */
+  std::unique_ptr<Image> downscaled() const;
+
+  /** Returns a copy of part of the image, which must lie inside it */
+  std::unique_ptr<Image> cropped(int x, int y, int width, int height) const;
+
+  /** Creates a GPU texture holding a copy of this image. Main thread only. */
+  std::unique_ptr<Texture> upload(Window& window) const;
+
+private:
+  SDL_Surface* m_surface;
+
+private:
+  Image(const Image&) = delete;
+  Image& operator=(const Image&) = delete;
+};
+
+#endif
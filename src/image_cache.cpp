@@ -0,0 +1,238 @@
+//  SuperTux Tile Manager - A utility for SuperTux to manage tiles
+//  Copyright (C) 2021 Semphris <semphris@protonmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "image_cache.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <vector>
+
+#include "util/log.hpp"
+
+#include "image.hpp"
+#include "tile.hpp"
+
+namespace fs = std::filesystem;
+
+ImageCache g_image_cache(512 * 1024 * 1024);
+
+FileIdentity
+FileIdentity::of(const std::string& filename)
+{
+  std::error_code ec;
+  fs::path path = fs::weakly_canonical(filename, ec);
+  if (ec)
+    path = filename;
+
+  FileIdentity identity;
+  identity.path = path.string();
+  identity.size = fs::file_size(path, ec);
+  identity.mtime = ec ? 0 : fs::last_write_time(path, ec).time_since_epoch().count();
+  return identity;
+}
+
+bool
+FileIdentity::operator==(const FileIdentity& other) const
+{
+  return path == other.path && size == other.size && mtime == other.mtime;
+}
+
+CachedImage::CachedImage(const FileIdentity& identity) :
+  m_identity(identity),
+  m_loaded(),
+  m_image(),
+  m_bytes(0),
+  m_last_used(0),
+  m_accounted(false)
+{
+}
+
+bool
+CachedImage::is_current() const
+{
+  return FileIdentity::of(m_identity.path) == m_identity;
+}
+
+void
+CachedImage::load()
+{
+  // If decoding throws, the flag stays unset and the next caller retries.
+  std::call_once(m_loaded, [this]() {
+    m_image = Image::from_file(m_identity.path);
+    m_bytes = static_cast<size_t>(m_image->get_pitch()) * m_image->get_height();
+  });
+}
+
+ImageCache::ImageCache(size_t budget) :
+  m_mutex(),
+  m_entries(),
+  m_budget(budget),
+  m_bytes(0),
+  m_tick(0),
+  m_hits(0),
+  m_misses(0),
+  m_evictions(0)
+{
+}
+
+ImageHandle
+ImageCache::acquire(const std::string& filename)
+{
+  const FileIdentity identity = FileIdentity::of(filename);
+
+  std::shared_ptr<CachedImage> entry;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto& slot = m_entries[identity.path];
+    if (slot && slot->m_identity == identity)
+    {
+      m_hits++;
+    }
+    else
+    {
+      // Stale entries stay alive for whoever still holds them, but are
+      // no longer handed out.
+      if (slot && slot->m_accounted)
+        m_bytes -= slot->m_bytes;
+
+      slot = std::make_shared<CachedImage>(identity);
+      m_misses++;
+    }
+
+    entry = slot;
+    entry->m_last_used = ++m_tick;
+  }
+
+  try
+  {
+    entry->load();
+  }
+  catch (...)
+  {
+    // Don't keep failed entries around, the file may get fixed on disk.
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_entries.find(identity.path);
+    if (it != m_entries.end() && it->second == entry)
+      m_entries.erase(it);
+    throw;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (!entry->m_accounted)
+    {
+      entry->m_accounted = true;
+      m_bytes += entry->m_bytes;
+    }
+    trim_locked(m_budget);
+  }
+
+  return entry;
+}
+
+void
+ImageCache::set_budget(size_t budget)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_budget = budget;
+  trim_locked(m_budget);
+}
+
+size_t
+ImageCache::get_budget() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_budget;
+}
+
+ImageCache::Stats
+ImageCache::get_stats() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return { m_hits, m_misses, m_evictions, m_bytes, m_entries.size() };
+}
+
+void
+ImageCache::reset_stats()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_hits = 0;
+  m_misses = 0;
+  m_evictions = 0;
+}
+
+void
+ImageCache::clear()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  trim_locked(0);
+}
+
+void
+ImageCache::trim_locked(size_t budget)
+{
+  if (m_bytes <= budget)
+    return;
+
+  // Only entries nobody holds a handle to can go.
+  std::vector<std::unordered_map<std::string, std::shared_ptr<CachedImage>>::iterator> unused;
+  for (auto it = m_entries.begin(); it != m_entries.end(); ++it)
+    if (it->second.use_count() == 1 && it->second->m_accounted)
+      unused.push_back(it);
+
+  std::sort(unused.begin(), unused.end(), [](const auto& lhs, const auto& rhs) {
+    return lhs->second->m_last_used < rhs->second->m_last_used;
+  });
+
+  for (auto& it : unused)
+  {
+    if (m_bytes <= budget)
+      break;
+
+    m_bytes -= it->second->m_bytes;
+    m_entries.erase(it);
+    m_evictions++;
+  }
+}
+
+std::unordered_map<uint16_t, ImageHandle>
+acquire_group_images(const TileSelection& tiles, const std::string& action,
+                     const std::vector<size_t>* indices)
+{
+  std::unordered_map<uint16_t, ImageHandle> images;
+  const size_t count = indices ? indices->size() : tiles.size();
+  for (size_t i = 0; i < count; ++i)
+  {
+    const SelectedTile& tile = tiles[indices ? (*indices)[i] : i];
+    if (images.count(tile.handle.group))
+      continue;
+
+    auto& image = images[tile.handle.group];
+    const TileGroup& group = g_tilegroups.at(tile.handle.group);
+    try
+    {
+      image = g_image_cache.acquire(group.texture.get_identity().path);
+    }
+    catch (const std::exception& err)
+    {
+      log_warn << "Couldn't " << action << " " << group.file << ": " << err.what() << std::endl;
+    }
+  }
+  return images;
+}
@@ -0,0 +1,143 @@
+//  SuperTux Tile Manager - A utility for SuperTux to manage tiles
+//  Copyright (C) 2021 Semphris <semphris@protonmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _HEADER_STTILEMAN_IMAGE_CACHE_HPP
+#define _HEADER_STTILEMAN_IMAGE_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Image;
+class TileSelection;
+
+/** Identifies one version of a file on disk */
+struct FileIdentity
+{
+  static FileIdentity of(const std::string& filename);
+
+  std::string path;
+  uintmax_t size = 0;
+  int64_t mtime = 0;
+
+  bool operator==(const FileIdentity& other) const;
+  bool operator!=(const FileIdentity& other) const { return !(*this == other); }
+};
+
+/** An image shared through the ImageCache. Holders of a handle keep
+    the decoded pixels alive. */
+class CachedImage final
+{
+  friend class ImageCache;
+
+public:
+  CachedImage(const FileIdentity& identity);
+
+  const std::string& get_path() const { return m_identity.path; }
+  const FileIdentity& get_identity() const { return m_identity; }
+  const Image& get_image() const { return *m_image; }
+  size_t get_bytes() const { return m_bytes; }
+
+  /** Whether the file on disk still matches what was decoded */
+  bool is_current() const;
+
+private:
+  void load();
+
+private:
+  const FileIdentity m_identity;
+
+  std::once_flag m_loaded;
+  std::shared_ptr<Image> m_image;
+  size_t m_bytes;
+
+  // Guarded by the owning cache's mutex
+  uint64_t m_last_used;
+  bool m_accounted;
+
+private:
+  CachedImage(const CachedImage&) = delete;
+  CachedImage& operator=(const CachedImage&) = delete;
+};
+
+using ImageHandle = std::shared_ptr<const CachedImage>;
+
+/** Decoded images keyed by canonical path and file identity (size and
+    modification time), so that (tiles ...) blocks sharing a PNG only
+    decode it once. Entries that no handle refers to anymore are kept
+    around until the byte budget is exceeded, then evicted least
+    recently used first. Safe to use from several threads. */
+class ImageCache final
+{
+public:
+  struct Stats
+  {
+    size_t hits;
+    size_t misses;
+    size_t evictions;
+    size_t bytes;
+    size_t entries;
+  };
+
+public:
+  ImageCache(size_t budget);
+
+  /** Returns the decoded image, loading it if needed. Throws if the
+      image can't be loaded. */
+  ImageHandle acquire(const std::string& filename);
+
+  void set_budget(size_t budget);
+  size_t get_budget() const;
+
+  Stats get_stats() const;
+  void reset_stats();
+
+  /** Drops every entry that isn't referenced anymore */
+  void clear();
+
+private:
+  void trim_locked(size_t budget);
+
+private:
+  mutable std::mutex m_mutex;
+  std::unordered_map<std::string, std::shared_ptr<CachedImage>> m_entries;
+  size_t m_budget;
+  size_t m_bytes;
+  uint64_t m_tick;
+  size_t m_hits;
+  size_t m_misses;
+  size_t m_evictions;
+
+private:
+  ImageCache(const ImageCache&) = delete;
+  ImageCache& operator=(const ImageCache&) = delete;
+};
+
+extern ImageCache g_image_cache;
+
+/** Acquires the images of the groups the given tiles come from, keyed by
+    group index, so that workers only read decoded pixels. Only the tiles
+    listed in indices are looked at, if given. Groups whose image fails
+    to load map to nullptr, after a warning "Couldn't <action> <file>". */
+std::unordered_map<uint16_t, ImageHandle> acquire_group_images(const TileSelection& tiles,
+                                                               const std::string& action,
+                                                               const std::vector<size_t>* indices = nullptr);
+
+#endif
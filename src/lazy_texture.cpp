@@ -0,0 +1,37 @@
+//  SuperTux Tile Manager - A utility for SuperTux to manage tiles
+//  Copyright (C) 2021 Semphris <semphris@protonmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "lazy_texture.hpp"
+
+#include "image.hpp"
+
+LazyTexture::LazyTexture() :
+  m_identity(),
+  m_size()
+{
+}
+
+LazyTexture::LazyTexture(const std::string& filename) :
+  m_identity(FileIdentity::of(filename)),
+  m_size(Image::read_size(filename))
+{
+}
+
+bool
+LazyTexture::is_current() const
+{
+  return !m_identity.path.empty() && FileIdentity::of(m_identity.path) == m_identity;
+}
@@ -0,0 +1,47 @@
+//  SuperTux Tile Manager - A utility for SuperTux to manage tiles
+//  Copyright (C) 2021 Semphris <semphris@protonmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _HEADER_STTILEMAN_LAZY_TEXTURE_HPP
+#define _HEADER_STTILEMAN_LAZY_TEXTURE_HPP
+
+#include <string>
+
+#include "util/size.hpp"
+
+#include "image_cache.hpp"
+
+/** Handle to the image of a TileGroup. Creating one only reads the
+    image header; the pixels are decoded through g_image_cache and
+    uploaded by whoever draws them: PagedTexture for the sheet and its
+    mip levels, TileAtlas for selected tiles. */
+class LazyTexture final
+{
+public:
+  LazyTexture();
+  LazyTexture(const std::string& filename);
+
+  /** Whether the file on disk is still the one the header was read from */
+  bool is_current() const;
+
+  const Size& get_size() const { return m_size; }
+  const FileIdentity& get_identity() const { return m_identity; }
+
+private:
+  FileIdentity m_identity;
+  Size m_size;
+};
+
+#endif
@@ -16,6 +16,10 @@
 
 #include "main.hpp"
 
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
 #include "SDL.h"
 #include "SDL_image.h"
 #include "SDL_ttf.h"
@@ -25,7 +29,13 @@
 #include "video/drawing_context.hpp"
 #include "video/font.hpp"
 
+#include "control_layer.hpp"
+#include "image_cache.hpp"
+#include "mip_cache.hpp"
+#include "tile_atlas.hpp"
 #include "tile_selector.hpp"
+#include "tileset_validator.hpp"
+#include "tileset_watcher.hpp"
 
 std::unique_ptr<Scene> g_scene;
 
@@ -34,28 +44,98 @@ void change_scene(std::unique_ptr<Scene> scene)
   g_scene = std::move(scene);
 }
 
+/** How long a frame lasts at the display's refresh rate */
+static Uint32 get_frame_time()
+{
+  SDL_DisplayMode mode;
+  if (SDL_GetCurrentDisplayMode(0, &mode) == 0 && mode.refresh_rate > 0)
+    return std::max(1, 1000 / mode.refresh_rate);
+  return 1000 / 60;
+}
+
 void run_loops(SDLWindow& w)
 {
+  // How often to look for tileset changes while nothing else happens
+  const int watch_interval = 100;
+
+  const Uint32 frame_time = get_frame_time();
+  Uint32 last_update = SDL_GetTicks();
+  Uint32 last_frame = last_update - frame_time;
+
   while (g_scene)
   {
+    // Sleep until the next frame is due if there is something to draw,
+    // otherwise until something happens.
+    int timeout = -1;
+    if (g_scene->is_dirty() || g_scene->is_animating())
+      timeout = static_cast<int>(frame_time - std::min(frame_time, SDL_GetTicks() - last_frame));
+    else if (g_tileset_watcher.is_watching())
+      timeout = watch_interval;
+
     SDL_Event e;
-    while (g_scene && SDL_PollEvent(&e))
+    if (timeout < 0 ? SDL_WaitEvent(&e) : SDL_WaitEventTimeout(&e, timeout))
     {
       g_scene->event(e);
+      while (g_scene && SDL_PollEvent(&e))
+        g_scene->event(e);
     }
 
-    if (g_scene)
-      g_scene->update(1.f / 64.f);
+    const Uint32 now = SDL_GetTicks();
+    const float dt_sec = static_cast<float>(now - last_update) / 1000.f;
+    last_update = now;
+
+    if (g_scene && g_tileset_watcher.update(dt_sec))
+    {
+      g_scene->tileset_reloaded();
+      if (g_scene)
+        g_scene->invalidate();
+    }
 
     if (g_scene)
+      g_scene->update(dt_sec);
+
+    if (g_scene && (g_scene->is_dirty() || g_scene->is_animating()) &&
+        now - last_frame >= frame_time)
+    {
+      g_scene->clear_dirty();
       g_scene->draw();
+      last_frame = now;
+    }
+  }
+}
 
-    SDL_Delay(15);
+int validate(const char* folder)
+{
+  IMG_Init(IMG_INIT_PNG);
+
+  int status = 0;
+  try
+  {
+    TilesetValidator validator(folder);
+    status = validator.run(std::cout) == 0 ? 0 : 1;
+  }
+  catch (const std::exception& e)
+  {
+    log_fatal << e.what() << std::endl;
+    status = 2;
   }
+
+  IMG_Quit();
+  return status;
 }
 
-int main()
+int main(int argc, char** argv)
 {
+  if (argc >= 2 && std::strcmp(argv[1], "--validate") == 0)
+  {
+    if (argc != 3)
+    {
+      std::cerr << "Usage: " << argv[0] << " --validate <folder>" << std::endl;
+      return 2;
+    }
+    return validate(argv[2]);
+  }
+
   SDL_Init(SDL_INIT_VIDEO);
   IMG_Init(IMG_INIT_PNG);
   TTF_Init();
@@ -69,6 +149,20 @@ int main()
     g_scene = std::make_unique<TileSelector>(w);
 
     run_loops(w);
+
+    log_info << "Control layers: " << ControlLayer::get_renders() << " renders, "
+             << ControlLayer::get_allocations() << " allocations, "
+             << ControlLayer::get_allocations_avoided() << " allocations avoided" << std::endl;
+    log_info << "Tile atlas: " << g_tile_atlas.get_page_count() << " pages, "
+             << g_tile_atlas.get_uploads() << " uploads" << std::endl;
+    const auto images = g_image_cache.get_stats();
+    log_info << "Image cache since the last import: " << images.hits << " hits, " << images.misses
+             << " misses, " << images.evictions << " evictions, " << images.entries << " entries, "
+             << images.bytes << " bytes" << std::endl;
+
+    // Textures must go before the renderer does
+    g_mip_cache.clear();
+    g_tile_atlas.clear();
   }
   catch (const std::exception& e)
   {
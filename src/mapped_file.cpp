@@ -0,0 +1,94 @@
+//  SuperTux Tile Manager - A utility for SuperTux to manage tiles
+//  Copyright (C) 2021 Semphris <semphris@protonmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "mapped_file.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define STTILEMAN_HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static void throw_open_error(const std::string& filename)
+{
+  std::stringstream msg;
+  msg << "Parser problem: Couldn't open file '" << filename << "'.";
+  throw std::runtime_error(msg.str());
+}
+
+MappedFile::MappedFile(const std::string& filename) :
+  m_filename(filename),
+  m_data(nullptr),
+  m_size(0),
+  m_mapped(false),
+  m_buffer()
+{
+#ifdef STTILEMAN_HAVE_MMAP
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw_open_error(filename);
+
+  struct stat st;
+  if (fstat(fd, &st) != 0)
+  {
+    close(fd);
+    throw_open_error(filename);
+  }
+
+  m_size = static_cast<size_t>(st.st_size);
+
+  // mmap() refuses zero-length mappings; an empty file is simply empty.
+  if (m_size > 0)
+  {
+    void* addr = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr != MAP_FAILED)
+    {
+      madvise(addr, m_size, MADV_SEQUENTIAL);
+      m_data = static_cast<const char*>(addr);
+      m_mapped = true;
+    }
+  }
+
+  close(fd);
+
+  if (m_mapped || m_size == 0)
+    return;
+#endif
+
+  std::ifstream in(filename, std::ios::binary);
+  if (!in.good())
+    throw_open_error(filename);
+
+  std::ostringstream contents;
+  contents << in.rdbuf();
+  m_buffer = contents.str();
+  m_data = m_buffer.data();
+  m_size = m_buffer.size();
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef STTILEMAN_HAVE_MMAP
+  if (m_mapped)
+    munmap(const_cast<char*>(m_data), m_size);
+#endif
+}
@@ -0,0 +1,50 @@
+//  SuperTux Tile Manager - A utility for SuperTux to manage tiles
+//  Copyright (C) 2021 Semphris <semphris@protonmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _HEADER_STTILEMAN_MAPPED_FILE_HPP
+#define _HEADER_STTILEMAN_MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+/** Read-only view of a whole file. Uses mmap() where available and
+    falls back to reading the file into memory elsewhere. */
+class MappedFile final
+{
+public:
+  MappedFile(const std::string& filename);
+  ~MappedFile();
+
+  const char* data() const { return m_data; }
+  size_t size() const { return m_size; }
+  std::string_view view() const { return std::string_view(m_data, m_size); }
+
+  const std::string& get_filename() const { return m_filename; }
+
+private:
+  std::string m_filename;
+  const char* m_data;
+  size_t m_size;
+  bool m_mapped;
+  std::string m_buffer;
+
+private:
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+};
+
+#endif
@@ -0,0 +1,142 @@
+//  SuperTux Tile Manager - A utility for SuperTux to manage tiles
+//  Copyright (C) 2021 Semphris <semphris@protonmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "mask_inference.hpp"
+
+#include <algorithm>
+#include <bitset>
+
+#include "image.hpp"
+#include "image_cache.hpp"
+#include "parallel.hpp"
+#include "tile.hpp"
+
+namespace {
+
+const int TILE_SIZE = 32;
+
+// Same bits as shown by TileMaskSelector: red, green and blue
+const uint8_t MASK_EMPTY = 0x1;
+const uint8_t MASK_SOLID = 0x2;
+const uint8_t MASK_NON_SOLID = 0x4;
+
+int count_bits(uint32_t bits)
+{
+  return static_cast<int>(std::bitset<32>(bits).count());
+}
+
+EdgeGuess classify(int opaque, bool non_solid)
+{
+  EdgeGuess guess;
+  guess.coverage = static_cast<float>(opaque) / static_cast<float>(TILE_SIZE * MaskInference::STRIP_WIDTH);
+
+  const uint8_t solid = non_solid ? MASK_NON_SOLID : MASK_SOLID;
+  if (guess.coverage < MaskInference::EMPTY_BELOW)
+  {
+    guess.mask = MASK_EMPTY;
+    guess.confidence = 1.f - guess.coverage / MaskInference::EMPTY_BELOW;
+  }
+  else if (guess.coverage >= MaskInference::SOLID_FROM)
+  {
+    guess.mask = solid;
+    guess.confidence = (guess.coverage - MaskInference::SOLID_FROM) / (1.f - MaskInference::SOLID_FROM);
+  }
+  else
+  {
+    guess.mask = MASK_EMPTY | solid;
+    const float half = (MaskInference::SOLID_FROM - MaskInference::EMPTY_BELOW) / 2.f;
+    guess.confidence = std::min(guess.coverage - MaskInference::EMPTY_BELOW,
+                                MaskInference::SOLID_FROM - guess.coverage) / half;
+  }
+
+  // A single opaque pixel right at a threshold still means something
+  guess.confidence = std::max(0.f, std::min(1.f, guess.confidence));
+  return guess;
+}
+
+} // namespace
+
+namespace MaskInference {
+
+MaskGuess
+infer(const Image& image, const Rect& srcrect, bool non_solid)
+{
+  const int x1 = static_cast<int>(srcrect.x1);
+  const int y1 = static_cast<int>(srcrect.y1);
+
+  // One bitmask per row of the tile, with the parts outside the image clear
+  uint32_t rows[TILE_SIZE] = {};
+  if (x1 >= 0 && x1 + TILE_SIZE <= image.get_width())
+  {
+    for (int y = std::max(0, -y1); y < TILE_SIZE && y1 + y < image.get_height(); ++y)
+      rows[y] = Image::get_opaque_bits(image.get_pixels() + (y1 + y) * image.get_pitch() + x1 * 4);
+  }
+  else
+  {
+    for (int y = std::max(0, -y1); y < TILE_SIZE && y1 + y < image.get_height(); ++y)
+      for (int x = std::max(0, -x1); x < TILE_SIZE && x1 + x < image.get_width(); ++x)
+        if (image.get_pixels()[(y1 + y) * image.get_pitch() + (x1 + x) * 4 + 3] >= 128)
+          rows[y] |= uint32_t(1) << x;
+  }
+
+  const uint32_t left_columns = (uint32_t(1) << STRIP_WIDTH) - 1;
+  const uint32_t right_columns = left_columns << (TILE_SIZE - STRIP_WIDTH);
+
+  int up = 0, left = 0, down = 0, right = 0;
+  for (int y = 0; y < TILE_SIZE; ++y)
+  {
+    if (y < STRIP_WIDTH)
+      up += count_bits(rows[y]);
+    if (y >= TILE_SIZE - STRIP_WIDTH)
+      down += count_bits(rows[y]);
+    left += count_bits(rows[y] & left_columns);
+    right += count_bits(rows[y] & right_columns);
+  }
+
+  MaskGuess guess;
+  guess.edges[0] = classify(up, non_solid);
+  guess.edges[1] = classify(left, non_solid);
+  guess.edges[2] = classify(down, non_solid);
+  guess.edges[3] = classify(right, non_solid);
+  return guess;
+}
+
+std::vector<MaskGuess>
+infer_all(const TileSelection& tiles)
+{
+  const auto images = acquire_group_images(tiles, "guess masks for");
+
+  std::vector<MaskGuess> guesses(tiles.size());
+  parallel_for(tiles.size(), [&](size_t i) {
+    const SelectedTile& tile = tiles[i];
+    const ImageHandle& image = images.at(tile.handle.group);
+    if (!image)
+    {
+      guesses[i].edges[0] = { tile.mask_up, 0.f, 0.f };
+      guesses[i].edges[1] = { tile.mask_left, 0.f, 0.f };
+      guesses[i].edges[2] = { tile.mask_down, 0.f, 0.f };
+      guesses[i].edges[3] = { tile.mask_right, 0.f, 0.f };
+      return;
+    }
+
+    guesses[i] = infer(image->get_image(), tiles.get_srcrect(i), tile.non_solid);
+  });
+
+  return guesses;
+}
+
+} // namespace MaskInference
@@ -0,0 +1,65 @@
+//  SuperTux Tile Manager - A utility for SuperTux to manage tiles
+//  Copyright (C) 2021 Semphris <semphris@protonmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef _HEADER_STTILEMAN_MASK_INFERENCE_HPP
+#define _HEADER_STTILEMAN_MASK_INFERENCE_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "util/rect.hpp"
+
+class Image;
+class TileSelection;
+
+/** What the pixels along one edge of a tile suggest its mask is */
+struct EdgeGuess
+{
+  uint8_t mask;
+  /** Share of the edge strip that is opaque, from 0 to 1 */
+  float coverage;
+  /** How far coverage is from the thresholds, from 0 (a coin toss) to 1 */
+  float confidence;
+};
+
+/** Edges in the order of TileAdjacency::Direction: up, left, down, right */
+struct MaskGuess
+{
+  EdgeGuess edges[4];
+};
+
+/** Edges are judged on the outermost STRIP_WIDTH rows or columns of the
+    tile. A pixel counts as opaque from an alpha of 128. An edge is empty
+    below EMPTY_BELOW coverage, solid from SOLID_FROM, and both otherwise;
+    tiles marked non-solid get the non-solid bit instead of the solid one. */
+namespace MaskInference {
+
+const int STRIP_WIDTH = 2;
+const float EMPTY_BELOW = .1f;
+const float SOLID_FROM = .9f;
+
+/** Guesses the masks of one 32x32 tile. Parts of srcrect outside the
+    image count as transparent. */
+MaskGuess infer(const Image& image, const Rect& srcrect, bool non_solid);
+
+/** Guesses the masks of every selected tile, on the worker threads.
+    Tiles whose image can't be loaded get a confidence of 0. */
+std::vector<MaskGuess> infer_all(const TileSelection& tiles);
+
+} // namespace MaskInference
+
+#endif
@@ -0,0 +1,172 @@
+//  SuperTux Tile Manager - A utility for SuperTux to manage tiles
+//  Copyright (C) 2021 Semphris <semphris@protonmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "mip_cache.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+#include "util/log.hpp"
+
+#include "image.hpp"
+
+MipCache g_mip_cache(16);
+
+MipCache::MipCache(size_t max_chains) :
+  m_chains(),
+  m_stale(),
+  m_max_chains(max_chains),
+  m_tick(0)
+{
+}
+
+PagedTexture*
+MipCache::get(const FileIdentity& identity, int level)
+{
+  if (level < 1 || level > MAX_LEVEL)
+    return nullptr;
+
+  if (!m_stale.empty())
+    reap_stale();
+
+  auto it = m_chains.find(identity.path);
+  if (it == m_chains.end() || it->second.identity != identity)
+  {
+    Chain chain;
+    chain.identity = identity;
+    chain.images = std::async(std::launch::async, &MipCache::build, identity);
+    chain.failed = false;
+    chain.last_used = 0;
+
+    if (it != m_chains.end())
+    {
+      if (is_running(it->second.images))
+        m_stale.push_back(std::move(it->second.images));
+      it->second = std::move(chain);
+    }
+    else
+      it = m_chains.emplace(identity.path, std::move(chain)).first;
+
+    trim();
+    it = m_chains.find(identity.path);
+  }
+
+  Chain& chain = it->second;
+  chain.last_used = ++m_tick;
+
+  if (chain.levels.empty() && !chain.failed)
+  {
+    if (chain.images.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+      return nullptr;
+
+    try
+    {
+      for (auto& image : chain.images.get())
+        chain.levels.push_back(std::make_unique<PagedTexture>(std::shared_ptr<const Image>(std::move(image))));
+    }
+    catch (const std::exception& err)
+    {
+      // Drawing falls back to the full size image
+      log_warn << "Couldn't build mipmaps for " << identity.path << ": " << err.what() << std::endl;
+      chain.levels.clear();
+      chain.failed = true;
+    }
+  }
+
+  if (chain.failed)
+    return nullptr;
+  return chain.levels[level - 1].get();
+}
+
+void
+MipCache::release_unused()
+{
+  for (auto& entry : m_chains)
+  {
+    for (auto& level : entry.second.levels)
+      level->release_unused();
+  }
+}
+
+bool
+MipCache::is_building() const
+{
+  for (const auto& entry : m_chains)
+  {
+    if (is_running(entry.second.images))
+      return true;
+  }
+  return false;
+}
+
+void
+MipCache::clear()
+{
+  m_chains.clear();
+  m_stale.clear();
+}
+
+std::vector<std::unique_ptr<Image>>
+MipCache::build(const FileIdentity& identity)
+{
+  const auto source = g_image_cache.acquire(identity.path);
+
+  std::vector<std::unique_ptr<Image>> levels;
+  const Image* image = &source->get_image();
+  for (int level = 1; level <= MAX_LEVEL; ++level)
+  {
+    levels.push_back(image->downscaled());
+    image = levels.back().get();
+  }
+  return levels;
+}
+
+bool
+MipCache::is_running(const Build& build)
+{
+  return build.valid() && build.wait_for(std::chrono::seconds(0)) != std::future_status::ready;
+}
+
+void
+MipCache::trim()
+{
+  while (m_chains.size() > m_max_chains)
+  {
+    // Chains still being computed are left alone; dropping one would
+    // block until it is done.
+    auto oldest = m_chains.end();
+    for (auto it = m_chains.begin(); it != m_chains.end(); ++it)
+    {
+      const Chain& chain = it->second;
+      if (is_running(chain.images))
+        continue;
+      if (oldest == m_chains.end() || chain.last_used < oldest->second.last_used)
+        oldest = it;
+    }
+
+    if (oldest == m_chains.end())
+      return;
+    m_chains.erase(oldest);
+  }
+}
+
+void
+MipCache::reap_stale()
+{
+  m_stale.erase(std::remove_if(m_stale.begin(), m_stale.end(), [](const Build& build) {
+                  return !is_running(build);
+                }), m_stale.end());
+}
@@ -0,0 +1,93 @@
+//  SuperTux Tile Manager - A utility for SuperTux to manage tiles
+//  Copyright (C) 2021 Semphris <semphris@protonmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _HEADER_STTILEMAN_MIP_CACHE_HPP
+#define _HEADER_STTILEMAN_MIP_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "image_cache.hpp"
+#include "paged_texture.hpp"
+
+class Image;
+
+/** Copies of images at 1/2, 1/4 and 1/8 of their size, for drawing them
+    small without aliasing. Each chain is computed once, on a background
+    thread; until it is ready, callers draw the full size image. Levels
+    are paged like the full size image, since a level of a large sheet
+    may still exceed the texture size limit. Main thread only. */
+class MipCache final
+{
+public:
+  static const int MAX_LEVEL = 3;
+
+public:
+  MipCache(size_t max_chains);
+
+  /** Returns the image at 1/2^level of its size, level being 1 to
+      MAX_LEVEL, or nullptr while the chain is still being computed. */
+  PagedTexture* get(const FileIdentity& identity, int level);
+
+  /** Releases the pages of every level that weren't drawn since the last call */
+  void release_unused();
+
+  /** Whether some chain is still being computed */
+  bool is_building() const;
+
+  /** Releases every texture; must be called before the window goes away.
+      Waits for chains that are still being computed. */
+  void clear();
+
+private:
+  using Build = std::future<std::vector<std::unique_ptr<Image>>>;
+
+  struct Chain
+  {
+    FileIdentity identity;
+    Build images;
+    std::vector<std::unique_ptr<PagedTexture>> levels;
+    bool failed;
+    uint64_t last_used;
+  };
+
+  static std::vector<std::unique_ptr<Image>> build(const FileIdentity& identity);
+  static bool is_running(const Build& build);
+  void trim();
+  void reap_stale();
+
+private:
+  std::unordered_map<std::string, Chain> m_chains;
+  /** Builds for a file that changed while they ran. Destroying their
+      futures would block until they finish, so they are kept here and
+      dropped once done. */
+  std::vector<Build> m_stale;
+  size_t m_max_chains;
+  uint64_t m_tick;
+
+private:
+  MipCache(const MipCache&) = delete;
+  MipCache& operator=(const MipCache&) = delete;
+};
+
+extern MipCache g_mip_cache;
+
+#endif
@@ -0,0 +1,142 @@
+//  SuperTux Tile Manager - A utility for SuperTux to manage tiles
+//  Copyright (C) 2021 Semphris <semphris@protonmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "paged_texture.hpp"
+
+#include <algorithm>
+
+#include "video/texture.hpp"
+#include "video/window.hpp"
+
+#include "image.hpp"
+
+namespace {
+
+Rect intersect(const Rect& a, const Rect& b)
+{
+  return Rect(std::max(a.x1, b.x1), std::max(a.y1, b.y1),
+              std::min(a.x2, b.x2), std::min(a.y2, b.y2));
+}
+
+bool is_empty(const Rect& rect)
+{
+  return rect.x2 <= rect.x1 || rect.y2 <= rect.y1;
+}
+
+} // namespace
+
+PagedTexture::PagedTexture(const FileIdentity& identity) :
+  m_identity(identity),
+  m_image(),
+  m_columns(0),
+  m_rows(0),
+  m_pages(),
+  m_used()
+{
+}
+
+PagedTexture::PagedTexture(std::shared_ptr<const Image> image) :
+  m_identity(),
+  m_image(std::move(image)),
+  m_columns(0),
+  m_rows(0),
+  m_pages(),
+  m_used()
+{
+}
+
+void
+PagedTexture::load()
+{
+  if (m_columns > 0)
+    return;
+
+  if (!m_image)
+  {
+    const ImageHandle handle = g_image_cache.acquire(m_identity.path);
+    m_image = std::shared_ptr<const Image>(handle, &handle->get_image());
+  }
+
+  m_columns = (m_image->get_width() + PAGE_SIZE - 1) / PAGE_SIZE;
+  m_rows = (m_image->get_height() + PAGE_SIZE - 1) / PAGE_SIZE;
+  m_pages.assign(m_columns * m_rows, nullptr);
+  m_used.assign(m_columns * m_rows, false);
+}
+
+void
+PagedTexture::draw(Window& window, const Rect& src, const Rect& dst, const Rect& clip, const DrawFunc& func)
+{
+  if (is_empty(src) || is_empty(dst))
+    return;
+
+  load();
+
+  const Image& image = *m_image;
+  const float scale_x = dst.width() / src.width();
+  const float scale_y = dst.height() / src.height();
+
+  const int first_column = std::max(0, static_cast<int>(src.x1) / PAGE_SIZE);
+  const int last_column = std::min(m_columns - 1, static_cast<int>(src.x2 - 1.f) / PAGE_SIZE);
+  const int first_row = std::max(0, static_cast<int>(src.y1) / PAGE_SIZE);
+  const int last_row = std::min(m_rows - 1, static_cast<int>(src.y2 - 1.f) / PAGE_SIZE);
+
+  for (int row = first_row; row <= last_row; ++row)
+  {
+    for (int column = first_column; column <= last_column; ++column)
+    {
+      const int x = column * PAGE_SIZE;
+      const int y = row * PAGE_SIZE;
+      const int width = std::min(PAGE_SIZE, image.get_width() - x);
+      const int height = std::min(PAGE_SIZE, image.get_height() - y);
+
+      const Rect page_rect(static_cast<float>(x), static_cast<float>(y),
+                           static_cast<float>(x + width), static_cast<float>(y + height));
+      const Rect part = intersect(page_rect, src);
+      if (is_empty(part))
+        continue;
+
+      const Rect part_dst(dst.x1 + (part.x1 - src.x1) * scale_x, dst.y1 + (part.y1 - src.y1) * scale_y,
+                          dst.x1 + (part.x2 - src.x1) * scale_x, dst.y1 + (part.y2 - src.y1) * scale_y);
+      if (is_empty(intersect(part_dst, clip)))
+        continue;
+
+      const size_t index = row * m_columns + column;
+      if (!m_pages[index])
+        m_pages[index] = image.cropped(x, y, width, height)->upload(window);
+      m_used[index] = true;
+
+      func(*m_pages[index], Rect(part.x1 - x, part.y1 - y, part.x2 - x, part.y2 - y), part_dst);
+    }
+  }
+}
+
+void
+PagedTexture::release_unused()
+{
+  for (size_t i = 0; i < m_pages.size(); ++i)
+  {
+    if (!m_used[i])
+      m_pages[i].reset();
+    m_used[i] = false;
+  }
+}
+
+size_t
+PagedTexture::get_resident_pages() const
+{
+  return std::count_if(m_pages.begin(), m_pages.end(),
+                       [](const std::shared_ptr<Texture>& page) { return page != nullptr; });
+}
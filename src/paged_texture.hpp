@@ -0,0 +1,79 @@
+//  SuperTux Tile Manager - A utility for SuperTux to manage tiles
+//  Copyright (C) 2021 Semphris <semphris@protonmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _HEADER_STTILEMAN_PAGED_TEXTURE_HPP
+#define _HEADER_STTILEMAN_PAGED_TEXTURE_HPP
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "util/rect.hpp"
+
+#include "image_cache.hpp"
+
+class Image;
+class Texture;
+class Window;
+
+/** An image held on the GPU as a grid of pages, none larger than
+    PAGE_SIZE, so that sheets of any size can be drawn. Pages are
+    uploaded from the decoded image the first time they are drawn, and
+    released once a frame goes by without them. Main thread only. */
+class PagedTexture final
+{
+public:
+  /** Well below the texture size limit of any renderer */
+  static const int PAGE_SIZE = 1024;
+
+  using DrawFunc = std::function<void(const Texture& page, const Rect& src, const Rect& dst)>;
+
+public:
+  /** Pages the image file, decoded through g_image_cache */
+  PagedTexture(const FileIdentity& identity);
+  /** Pages an image that was decoded elsewhere, such as a mip level */
+  PagedTexture(std::shared_ptr<const Image> image);
+
+  /** Decodes the image, if that wasn't done yet. Pages are still only
+      uploaded once drawn. */
+  void load();
+
+  /** Splits drawing src of the image into dst into one call of func per
+      page. Pages whose part of dst lies outside clip are skipped. */
+  void draw(Window& window, const Rect& src, const Rect& dst, const Rect& clip, const DrawFunc& func);
+
+  /** Releases the pages that weren't drawn since the last call */
+  void release_unused();
+
+  const FileIdentity& get_identity() const { return m_identity; }
+  size_t get_resident_pages() const;
+
+private:
+  FileIdentity m_identity;
+  /** Decoded copy the pages are cut from; held while any page may be
+      needed. For files, it shares ownership with the cache handle. */
+  std::shared_ptr<const Image> m_image;
+  int m_columns;
+  int m_rows;
+  std::vector<std::shared_ptr<Texture>> m_pages;
+  std::vector<bool> m_used;
+
+private:
+  PagedTexture(const PagedTexture&) = delete;
+  PagedTexture& operator=(const PagedTexture&) = delete;
+};
+
+#endif
@@ -0,0 +1,239 @@
+//  SuperTux Tile Manager - A utility for SuperTux to manage tiles
+//  Copyright (C) 2021 Semphris <semphris@protonmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "pairing_queue.hpp"
+
+#include <unordered_map>
+
+#include "tile.hpp"
+
+namespace {
+
+const TileAdjacency::Direction ORDER[TileAdjacency::NUM_DIRECTIONS] = {
+  TileAdjacency::DOWN, TileAdjacency::UP, TileAdjacency::RIGHT, TileAdjacency::LEFT
+};
+
+size_t get_order(TileAdjacency::Direction dir)
+{
+  for (size_t i = 0; i < TileAdjacency::NUM_DIRECTIONS; ++i)
+    if (ORDER[i] == dir)
+      return i;
+  return TileAdjacency::NUM_DIRECTIONS;
+}
+
+uint8_t get_mask(const SelectedTile& tile, TileAdjacency::Direction dir)
+{
+  switch (dir)
+  {
+    case TileAdjacency::UP:
+      return tile.mask_up;
+    case TileAdjacency::LEFT:
+      return tile.mask_left;
+    case TileAdjacency::DOWN:
+      return tile.mask_down;
+    default:
+      return tile.mask_right;
+  }
+}
+
+bool test_bit(const TileAdjacency::Row& row, size_t index)
+{
+  return (row[index / 64] >> (index % 64)) & 1;
+}
+
+void clear_bit(TileAdjacency::Row& row, size_t index)
+{
+  row[index / 64] &= ~(uint64_t(1) << (index % 64));
+}
+
+} // namespace
+
+PairingQueue::PairingQueue() :
+  m_count(0),
+  m_rows(),
+  m_row(0),
+  m_match(0),
+  m_remaining(0),
+  m_total(0)
+{
+}
+
+void
+PairingQueue::build()
+{
+  m_count = g_selected_tiles.size();
+  const size_t words = (m_count + 63) / 64;
+
+  // The tiles each mask value accepts, keyed by non_solid + 1
+  std::unordered_map<unsigned int, TileAdjacency::Row> buckets;
+  for (size_t i = 0; i < m_count; ++i)
+  {
+    auto& bucket = buckets[g_selected_tiles[i].non_solid + 1u];
+    bucket.resize(words, 0);
+    bucket[i / 64] |= uint64_t(1) << (i % 64);
+  }
+
+  m_rows.assign(TileAdjacency::NUM_DIRECTIONS * m_count, TileAdjacency::Row(words, 0));
+  m_total = 0;
+
+  for (size_t order = 0; order < TileAdjacency::NUM_DIRECTIONS; ++order)
+  {
+    const auto dir = ORDER[order];
+    const auto mirror_dir = TileAdjacency::opposite(dir);
+    const bool mirror_first = get_order(mirror_dir) < order;
+
+    for (size_t tile = 0; tile < m_count; ++tile)
+    {
+      const auto bucket = buckets.find(get_mask(g_selected_tiles[tile], dir));
+      if (bucket == buckets.end())
+        continue;
+
+      TileAdjacency::Row& row = m_rows[order * m_count + tile];
+      const TileAdjacency::Row undecided = g_tile_adjacency.get_undecided(tile, dir);
+      for (size_t i = 0; i < words; ++i)
+        row[i] = undecided[i] & bucket->second[i];
+
+      // Answering the mirror answers this one too
+      if (mirror_first)
+      {
+        for (size_t match = TileAdjacency::find_next(row, 0); match != TileAdjacency::npos;
+             match = TileAdjacency::find_next(row, match + 1))
+        {
+          if (test_bit(m_rows[get_row(match, mirror_dir)], tile))
+            clear_bit(row, match);
+        }
+      }
+
+      m_total += TileAdjacency::count(row);
+    }
+  }
+
+  m_remaining = m_total;
+  m_row = 0;
+  m_match = 0;
+  advance();
+}
+
+PairingQueue::Candidate
+PairingQueue::front() const
+{
+  return { m_row % m_count, ORDER[m_row / m_count], m_match };
+}
+
+void
+PairingQueue::answer(bool include)
+{
+  if (!empty())
+    decide(front(), include);
+}
+
+void
+PairingQueue::decide(const Candidate& candidate, bool include)
+{
+  if (include)
+    g_tile_adjacency.include(candidate.tile, candidate.dir, candidate.match);
+  else
+    g_tile_adjacency.exclude(candidate.tile, candidate.dir, candidate.match);
+
+  remove(candidate.tile, candidate.dir, candidate.match);
+  remove(candidate.match, TileAdjacency::opposite(candidate.dir), candidate.tile);
+}
+
+std::vector<PairingQueue::Candidate>
+PairingQueue::get_batch(size_t max) const
+{
+  std::vector<Candidate> batch;
+  if (empty())
+    return batch;
+
+  const Candidate first = front();
+  const TileAdjacency::Row& row = m_rows[m_row];
+  for (size_t match = m_match; match != TileAdjacency::npos && batch.size() < max;
+       match = TileAdjacency::find_next(row, match + 1))
+    batch.push_back({ first.tile, first.dir, match });
+
+  return batch;
+}
+
+std::vector<PairingQueue::Candidate>
+PairingQueue::get_candidates() const
+{
+  std::vector<Candidate> candidates;
+  candidates.reserve(m_remaining);
+
+  for (size_t row = m_row; row < m_rows.size(); ++row)
+  {
+    const size_t tile = row % m_count;
+    const auto dir = ORDER[row / m_count];
+    for (size_t match = TileAdjacency::find_next(m_rows[row], 0); match != TileAdjacency::npos;
+         match = TileAdjacency::find_next(m_rows[row], match + 1))
+      candidates.push_back({ tile, dir, match });
+  }
+
+  return candidates;
+}
+
+bool
+PairingQueue::contains(size_t tile, TileAdjacency::Direction dir, size_t match) const
+{
+  return tile < m_count && match < m_count && test_bit(m_rows[get_row(tile, dir)], match);
+}
+
+void
+PairingQueue::remove(size_t tile, TileAdjacency::Direction dir, size_t match)
+{
+  if (tile >= m_count || match >= m_count)
+    return;
+
+  const size_t row = get_row(tile, dir);
+  if (!test_bit(m_rows[row], match))
+    return;
+
+  clear_bit(m_rows[row], match);
+  m_remaining--;
+
+  if (row == m_row && match == m_match)
+    advance();
+}
+
+size_t
+PairingQueue::get_row(size_t tile, TileAdjacency::Direction dir) const
+{
+  return get_order(dir) * m_count + tile;
+}
+
+void
+PairingQueue::advance()
+{
+  for (; m_row < m_rows.size(); ++m_row, m_match = 0)
+  {
+    TileAdjacency::Row& row = m_rows[m_row];
+    for (m_match = TileAdjacency::find_next(row, m_match); m_match != TileAdjacency::npos;
+         m_match = TileAdjacency::find_next(row, m_match + 1))
+    {
+      // Decided behind the queue's back, e.g. by loading a session
+      const Candidate candidate = front();
+      if (!g_tile_adjacency.is_decided(candidate.tile, candidate.dir, candidate.match))
+        return;
+
+      clear_bit(row, m_match);
+      m_remaining--;
+    }
+  }
+
+  m_match = 0;
+}
@@ -0,0 +1,91 @@
+//  SuperTux Tile Manager - A utility for SuperTux to manage tiles
+//  Copyright (C) 2021 Semphris <semphris@protonmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef _HEADER_STTILEMAN_PAIRING_QUEUE_HPP
+#define _HEADER_STTILEMAN_PAIRING_QUEUE_HPP
+
+#include <cstddef>
+#include <vector>
+
+#include "tile_adjacency.hpp"
+
+/** The pairings left to ask about, worked out once when the pairing
+    step starts. A pairing of match on the dir side of tile is asked
+    about if it is undecided and the mask of tile on that side equals
+    the non_solid value of match plus one. Questions come by direction
+    (down, up, right, left), then by tile, then by match; a pairing
+    whose mirror is already asked about isn't asked again. */
+class PairingQueue final
+{
+public:
+  struct Candidate
+  {
+    size_t tile;
+    TileAdjacency::Direction dir;
+    size_t match;
+  };
+
+public:
+  PairingQueue();
+
+  /** Lists the questions for g_selected_tiles and g_tile_adjacency */
+  void build();
+
+  bool empty() const { return m_row >= m_rows.size(); }
+  /** The question being asked; only valid if not empty() */
+  Candidate front() const;
+
+  /** Records the answer to front() in g_tile_adjacency and moves on */
+  void answer(bool include);
+  /** Records the answer to any queued question and drops it */
+  void decide(const Candidate& candidate, bool include);
+
+  /** Up to max questions from front(), all about the same tile and side */
+  std::vector<Candidate> get_batch(size_t max) const;
+
+  /** Every question still queued, in the order they would be asked */
+  std::vector<Candidate> get_candidates() const;
+
+  bool contains(size_t tile, TileAdjacency::Direction dir, size_t match) const;
+
+  /** Drops a question that was decided some other way. Does nothing if
+      it isn't queued. */
+  void remove(size_t tile, TileAdjacency::Direction dir, size_t match);
+
+  size_t get_remaining() const { return m_remaining; }
+  size_t get_total() const { return m_total; }
+
+private:
+  size_t get_row(size_t tile, TileAdjacency::Direction dir) const;
+  /** Moves to the first question at or after the current position */
+  void advance();
+
+private:
+  size_t m_count;
+  /** One row of matches per direction and tile, in the order asked */
+  std::vector<TileAdjacency::Row> m_rows;
+  size_t m_row;
+  size_t m_match;
+  size_t m_remaining;
+  size_t m_total;
+
+private:
+  PairingQueue(const PairingQueue&) = delete;
+  PairingQueue& operator=(const PairingQueue&) = delete;
+};
+
+#endif
@@ -0,0 +1,83 @@
+//  SuperTux Tile Manager - A utility for SuperTux to manage tiles
+//  Copyright (C) 2021 Semphris <semphris@protonmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+static thread_local bool s_in_parallel_for = false;
+
+unsigned int
+get_worker_count()
+{
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+void
+parallel_for(size_t count, const std::function<void(size_t)>& func)
+{
+  if (count == 0)
+    return;
+
+  std::atomic<size_t> next(0);
+  std::mutex error_mutex;
+  size_t error_index = count;
+  std::exception_ptr error;
+
+  auto worker = [&]() {
+    const bool was_in_parallel_for = s_in_parallel_for;
+    s_in_parallel_for = true;
+
+    for (size_t i = next++; i < count; i = next++)
+    {
+      try
+      {
+        func(i);
+      }
+      catch (...)
+      {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (i < error_index)
+        {
+          error_index = i;
+          error = std::current_exception();
+        }
+      }
+    }
+
+    s_in_parallel_for = was_in_parallel_for;
+  };
+
+  const size_t num_threads = s_in_parallel_for ? 1 : std::min<size_t>(get_worker_count(), count);
+  std::vector<std::thread> threads;
+  threads.reserve(num_threads - 1);
+  for (size_t i = 1; i < num_threads; ++i)
+    threads.emplace_back(worker);
+
+  // The calling thread takes its share of the work as well.
+  worker();
+
+  for (auto& thread : threads)
+    thread.join();
+
+  if (error)
+    std::rethrow_exception(error);
+}
@@ -0,0 +1,32 @@
+//  SuperTux Tile Manager - A utility for SuperTux to manage tiles
+//  Copyright (C) 2021 Semphris <semphris@protonmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _HEADER_STTILEMAN_PARALLEL_HPP
+#define _HEADER_STTILEMAN_PARALLEL_HPP
+
+#include <cstddef>
+#include <functional>
+
+/** Number of worker threads used by parallel_for() */
+unsigned int get_worker_count();
+
+/** Calls func(i) for every i in [0, count) on a set of worker threads
+    and waits for all of them. If some calls throw, the exception thrown
+    for the lowest index is rethrown once every call has finished.
+    Nested calls from inside func run on the calling thread. */
+void parallel_for(size_t count, const std::function<void(size_t)>& func);
+
+#endif
@@ -17,6 +17,7 @@
 #include "scene.hpp"
 
 Scene::Scene(Window& window) :
-  m_window(window)
+  m_window(window),
+  m_dirty(true)
 {
 }
@@ -33,9 +33,25 @@ public:
   virtual void update(float dt_sec) = 0;
   virtual void draw() const = 0;
 
+  /** Called after g_tilegroups was reloaded from disk */
+  virtual void tileset_reloaded() {}
+
+  /** Whether the scene changes on its own, without input, and must be
+      updated and drawn every frame */
+  virtual bool is_animating() const { return false; }
+
+  /** Asks for the scene to be drawn again on the next frame. Scenes
+      that are neither dirty nor animating are not drawn at all. */
+  void invalidate() { m_dirty = true; }
+  bool is_dirty() const { return m_dirty; }
+  void clear_dirty() { m_dirty = false; }
+
 protected:
   Window& m_window;
 
+private:
+  bool m_dirty;
+
 private:
   Scene(const Scene&) = delete;
   Scene& operator=(const Scene&) = delete;
@@ -0,0 +1,216 @@
+//  SuperTux Tile Manager - A utility for SuperTux to manage tiles
+//  Copyright (C) 2021 Semphris <semphris@protonmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "seam_scorer.hpp"
+
+#include <algorithm>
+#include <bitset>
+#include <cstring>
+#include <string_view>
+#include <unordered_map>
+
+#include "image.hpp"
+#include "image_cache.hpp"
+#include "parallel.hpp"
+#include "tile.hpp"
+#include "tile_set_cache.hpp"
+
+#ifdef STTILEMAN_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+const size_t EDGE_BYTES = SeamScorer::EDGE_LENGTH * 4;
+
+/** Sum of absolute differences of two edges, over every channel */
+uint32_t get_difference(const uint8_t* a, const uint8_t* b)
+{
+#ifdef STTILEMAN_USE_SSE2
+  __m128i sum = _mm_setzero_si128();
+  for (size_t i = 0; i < EDGE_BYTES; i += 16)
+  {
+    const __m128i pixels_a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+    const __m128i pixels_b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+    sum = _mm_add_epi64(sum, _mm_sad_epu8(pixels_a, pixels_b));
+  }
+  return static_cast<uint32_t>(_mm_cvtsi128_si32(sum) + _mm_cvtsi128_si32(_mm_srli_si128(sum, 8)));
+#else
+  uint32_t sum = 0;
+  for (size_t i = 0; i < EDGE_BYTES; ++i)
+    sum += a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+  return sum;
+#endif
+}
+
+/** Copies the pixels of one edge, from (x, y) in steps of (step_x, step_y) */
+void read_edge(const Image& image, int x, int y, int step_x, int step_y, uint8_t* edge)
+{
+  for (int i = 0; i < SeamScorer::EDGE_LENGTH; ++i, x += step_x, y += step_y)
+  {
+    uint8_t* pixel = edge + i * 4;
+    if (x < 0 || y < 0 || x >= image.get_width() || y >= image.get_height())
+    {
+      std::memset(pixel, 0, 4);
+      continue;
+    }
+
+    std::memcpy(pixel, image.get_pixels() + y * image.get_pitch() + x * 4, 4);
+    if (pixel[3] < 128)
+      std::memset(pixel, 0, 4);
+  }
+}
+
+} // namespace
+
+SeamScorer::SeamScorer() :
+  m_edges(),
+  m_loaded(),
+  m_classes(),
+  m_members(),
+  m_shared_edges(0),
+  m_largest_class(0)
+{
+}
+
+void
+SeamScorer::load(const TileSelection& tiles)
+{
+  const auto images = acquire_group_images(tiles, "read the edges of");
+
+  m_edges.assign(tiles.size() * TileAdjacency::NUM_DIRECTIONS * EDGE_BYTES, 0);
+  m_loaded.assign(tiles.size(), 0);
+
+  parallel_for(tiles.size(), [&](size_t i) {
+    const ImageHandle& handle = images.at(tiles[i].handle.group);
+    if (!handle)
+      return;
+
+    const Image& image = handle->get_image();
+    const Rect rect = tiles.get_srcrect(i);
+    const int x1 = static_cast<int>(rect.x1);
+    const int y1 = static_cast<int>(rect.y1);
+    const int last = EDGE_LENGTH - 1;
+
+    uint8_t* edges = m_edges.data() + i * TileAdjacency::NUM_DIRECTIONS * EDGE_BYTES;
+    read_edge(image, x1, y1, 1, 0, edges + TileAdjacency::UP * EDGE_BYTES);
+    read_edge(image, x1, y1, 0, 1, edges + TileAdjacency::LEFT * EDGE_BYTES);
+    read_edge(image, x1, y1 + last, 1, 0, edges + TileAdjacency::DOWN * EDGE_BYTES);
+    read_edge(image, x1 + last, y1, 0, 1, edges + TileAdjacency::RIGHT * EDGE_BYTES);
+    m_loaded[i] = 1;
+  });
+
+  build_classes();
+}
+
+SeamScorer::Score
+SeamScorer::score(size_t tile, TileAdjacency::Direction dir, size_t match) const
+{
+  const uint8_t* a = get_edge(tile, dir);
+  const uint8_t* b = get_edge(match, TileAdjacency::opposite(dir));
+
+  Score score;
+  score.difference = static_cast<float>(get_difference(a, b)) / (EDGE_BYTES * 255.f);
+  score.alpha_mismatches = static_cast<int>(std::bitset<32>(Image::get_opaque_bits(a) ^ Image::get_opaque_bits(b)).count());
+  return score;
+}
+
+SeamScorer::Verdict
+SeamScorer::judge(size_t tile, TileAdjacency::Direction dir, size_t match) const
+{
+  if (!is_loaded(tile) || !is_loaded(match))
+    return UNSURE;
+  return judge(score(tile, dir, match));
+}
+
+SeamScorer::Verdict
+SeamScorer::judge(const Score& score)
+{
+  if (score.alpha_mismatches == 0 && score.difference <= FITS_BELOW)
+    return FITS;
+  if (score.alpha_mismatches >= ALPHA_MISMATCHES || score.difference >= MISMATCH_FROM)
+    return DOESNT_FIT;
+  return UNSURE;
+}
+
+size_t
+SeamScorer::get_class(size_t tile, TileAdjacency::Direction dir) const
+{
+  return m_classes[tile * TileAdjacency::NUM_DIRECTIONS + dir];
+}
+
+void
+SeamScorer::build_classes()
+{
+  const size_t count = m_loaded.size();
+  m_classes.assign(count * TileAdjacency::NUM_DIRECTIONS, 0);
+  m_members.clear();
+
+  // Classes by hash of their edge; the edges are compared in full, as
+  // different edges may share a hash
+  std::unordered_map<uint64_t, std::vector<size_t>> by_hash;
+
+  for (size_t dir = 0; dir < TileAdjacency::NUM_DIRECTIONS; ++dir)
+  {
+    by_hash.clear();
+    for (size_t tile = 0; tile < count; ++tile)
+    {
+      const auto side = static_cast<TileAdjacency::Direction>(dir);
+      size_t& edge_class = m_classes[tile * TileAdjacency::NUM_DIRECTIONS + dir];
+
+      if (!m_loaded[tile])
+      {
+        edge_class = m_members.size();
+        m_members.push_back({ tile });
+        continue;
+      }
+
+      const uint8_t* edge = get_edge(tile, side);
+      auto& candidates = by_hash[TileSetCache::hash(std::string_view(reinterpret_cast<const char*>(edge), EDGE_BYTES))];
+      const auto it = std::find_if(candidates.begin(), candidates.end(), [&](size_t other) {
+        return std::memcmp(get_edge(m_members[other].front(), side), edge, EDGE_BYTES) == 0;
+      });
+
+      if (it != candidates.end())
+      {
+        edge_class = *it;
+        m_members[edge_class].push_back(tile);
+      }
+      else
+      {
+        edge_class = m_members.size();
+        m_members.push_back({ tile });
+        candidates.push_back(edge_class);
+      }
+    }
+  }
+
+  m_shared_edges = 0;
+  m_largest_class = 0;
+  for (const auto& members : m_members)
+  {
+    if (members.size() > 1)
+      m_shared_edges += members.size();
+    m_largest_class = std::max(m_largest_class, members.size());
+  }
+}
+
+const uint8_t*
+SeamScorer::get_edge(size_t tile, TileAdjacency::Direction dir) const
+{
+  return m_edges.data() + (tile * TileAdjacency::NUM_DIRECTIONS + dir) * EDGE_BYTES;
+}
@@ -0,0 +1,110 @@
+//  SuperTux Tile Manager - A utility for SuperTux to manage tiles
+//  Copyright (C) 2021 Semphris <semphris@protonmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef _HEADER_STTILEMAN_SEAM_SCORER_HPP
+#define _HEADER_STTILEMAN_SEAM_SCORER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "tile_adjacency.hpp"
+
+class TileSelection;
+
+/** Compares the pixels that would touch if two tiles were placed side
+    by side: the outermost row or column of each, 32 pixels long. Pixels
+    under half opacity count as fully transparent, so that whatever
+    color they hold doesn't matter.
+
+    Edges on the same side of different tiles that are identical once
+    read this way share a class; whatever fits one of them fits all. */
+class SeamScorer final
+{
+public:
+  static const int EDGE_LENGTH = 32;
+
+  /** Seams at most this different, with no pixel opaque on one side and
+      transparent on the other, surely fit */
+  static constexpr float FITS_BELOW = .03f;
+  /** Seams at least this different, or with at least this many pixels
+      opaque on one side only, surely don't */
+  static constexpr float MISMATCH_FROM = .25f;
+  static const int ALPHA_MISMATCHES = 8;
+
+  enum Verdict
+  {
+    FITS,
+    DOESNT_FIT,
+    UNSURE
+  };
+
+  struct Score
+  {
+    /** Mean absolute difference across all channels, from 0 to 1 */
+    float difference;
+    /** Pixels that are opaque on one side of the seam only */
+    int alpha_mismatches;
+  };
+
+public:
+  SeamScorer();
+
+  /** Reads the edges of every tile, on the worker threads */
+  void load(const TileSelection& tiles);
+
+  /** How well match fits on the dir side of tile. Only valid if both
+      could be loaded. */
+  Score score(size_t tile, TileAdjacency::Direction dir, size_t match) const;
+  bool is_loaded(size_t tile) const { return m_loaded[tile] != 0; }
+
+  /** The class of the dir edge of tile. Tiles that couldn't be loaded
+      are in a class of their own. */
+  size_t get_class(size_t tile, TileAdjacency::Direction dir) const;
+  /** The tiles whose edge, on the side of the class, is in it */
+  const std::vector<size_t>& get_class_members(size_t edge_class) const { return m_members[edge_class]; }
+
+  size_t get_class_count() const { return m_members.size(); }
+  /** Edges that share their class with some other edge */
+  size_t get_shared_edges() const { return m_shared_edges; }
+  size_t get_largest_class() const { return m_largest_class; }
+
+  /** UNSURE if either tile couldn't be loaded */
+  Verdict judge(size_t tile, TileAdjacency::Direction dir, size_t match) const;
+  static Verdict judge(const Score& score);
+
+private:
+  const uint8_t* get_edge(size_t tile, TileAdjacency::Direction dir) const;
+  void build_classes();
+
+private:
+  /** EDGE_LENGTH RGBA pixels per edge, four edges per tile, in the order
+      of TileAdjacency::Direction */
+  std::vector<uint8_t> m_edges;
+  std::vector<uint8_t> m_loaded;
+  /** The class of each edge, indexed like m_edges */
+  std::vector<size_t> m_classes;
+  std::vector<std::vector<size_t>> m_members;
+  size_t m_shared_edges;
+  size_t m_largest_class;
+
+private:
+  SeamScorer(const SeamScorer&) = delete;
+  SeamScorer& operator=(const SeamScorer&) = delete;
+};
+
+#endif
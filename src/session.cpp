@@ -0,0 +1,470 @@
+//  SuperTux Tile Manager - A utility for SuperTux to manage tiles
+//  Copyright (C) 2021 Semphris <semphris@protonmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "session.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "util/log.hpp"
+
+#include "supertux/util/reader_document.hpp"
+#include "supertux/util/reader_iterator.hpp"
+#include "supertux/util/reader_mapping.hpp"
+#include "supertux/util/writer.hpp"
+#include "tile.hpp"
+#include "tile_id_index.hpp"
+
+namespace fs = std::filesystem;
+
+// Bump when the snapshot layout changes; older sessions are then ignored
+static const int VERSION = 1;
+
+Session g_session;
+
+namespace {
+
+/** Ids are written as one-element unsigned lists, as Writer has no
+    scalar unsigned overload and ids may exceed INT_MAX */
+void write_id(Writer& writer, const std::string& name, uint32_t id)
+{
+  writer.write(name, std::vector<unsigned int>{ id });
+}
+
+void read_id(const ReaderMapping& entry, const char* name, uint32_t& id)
+{
+  std::vector<unsigned int> value;
+  if (entry.get(name, value) && value.size() == 1)
+    id = value[0];
+}
+
+/** All of a tile's masks and flags in one number, so that runs of
+    identical tiles compress well */
+unsigned int pack_masks(const SelectedTile& tile)
+{
+  return (tile.mask_up & 0x7u) | (tile.mask_left & 0x7u) << 3 | (tile.mask_down & 0x7u) << 6 |
+         (tile.mask_right & 0x7u) << 9 | (tile.non_solid & 0x1u) << 12 |
+         static_cast<unsigned int>(tile.flags) << 13;
+}
+
+void unpack_masks(unsigned int value, SelectedTile& tile)
+{
+  tile.mask_up = value & 0x7;
+  tile.mask_left = (value >> 3) & 0x7;
+  tile.mask_down = (value >> 6) & 0x7;
+  tile.mask_right = (value >> 9) & 0x7;
+  tile.non_solid = (value >> 12) & 0x1;
+  tile.flags = static_cast<uint8_t>(value >> 13);
+}
+
+} // namespace
+
+std::string
+Session::get_filename(const std::string& tileset)
+{
+  return tileset + ".session";
+}
+
+Session::Session() :
+  m_filename(),
+  m_step("selection"),
+  m_journal(),
+  m_journal_entries(0)
+{
+}
+
+std::string
+Session::open(const std::string& tileset)
+{
+  close();
+
+  m_filename = get_filename(tileset);
+  m_step = "selection";
+
+  try
+  {
+    restore();
+  }
+  catch (const std::exception& err)
+  {
+    log_warn << "Couldn't restore session '" << m_filename << "': " << err.what() << std::endl;
+    g_selected_tiles.clear();
+    m_step = "selection";
+  }
+
+  // Folds the journal into a fresh snapshot
+  save(m_step);
+  return m_step;
+}
+
+void
+Session::close()
+{
+  if (m_journal.is_open())
+    m_journal.close();
+  m_filename.clear();
+  m_journal_entries = 0;
+}
+
+void
+Session::save(const std::string& step)
+{
+  if (!is_open())
+    return;
+
+  m_step = step;
+  if (m_journal.is_open())
+    m_journal.close();
+
+  std::vector<uint32_t> ids;
+  std::vector<unsigned int> masks;
+  ids.reserve(g_selected_tiles.size());
+  for (const auto& tile : g_selected_tiles)
+  {
+    ids.push_back(tile.id);
+
+    // Value and count pairs
+    const unsigned int value = pack_masks(tile);
+    if (!masks.empty() && masks[masks.size() - 2] == value)
+      masks.back()++;
+    else
+      masks.insert(masks.end(), { value, 1u });
+  }
+
+  std::vector<uint64_t> bits(g_tile_adjacency.get_bit_count());
+  g_tile_adjacency.save_bits(bits.data());
+
+  const std::string tmp_filename = m_filename + ".tmp";
+  try
+  {
+    Writer writer(tmp_filename);
+    writer.write_comment("st-tilemanager session; entries after the snapshot are applied in order");
+    writer.start_list("snapshot");
+    writer.write("version", VERSION);
+    writer.write("step", m_step);
+    writer.write("tiles", encode_ids(ids), 16);
+    writer.write("masks", masks, 16);
+    writer.write("adjacency-size", static_cast<int>(g_tile_adjacency.size()));
+    writer.write("decisions", encode_bits(bits), 16);
+    writer.end_list("snapshot");
+  }
+  catch (const std::exception& err)
+  {
+    log_warn << "Couldn't save session '" << m_filename << "': " << err.what() << std::endl;
+    return;
+  }
+
+  // Replace the old file in one step, so that a crash never leaves half a snapshot
+  std::error_code ec;
+  fs::rename(tmp_filename, m_filename, ec);
+  if (ec)
+  {
+    log_warn << "Couldn't save session '" << m_filename << "': " << ec.message() << std::endl;
+    std::remove(tmp_filename.c_str());
+    return;
+  }
+
+  open_journal();
+}
+
+void
+Session::record_masks(size_t index)
+{
+  if (!m_journal.is_open())
+    return;
+
+  const SelectedTile& tile = g_selected_tiles[index];
+
+  Writer writer(m_journal);
+  writer.start_list("masks");
+  write_id(writer, "tile", tile.id);
+  writer.write("value", static_cast<int>(pack_masks(tile)));
+  writer.end_list("masks");
+
+  end_entry();
+}
+
+void
+Session::record_decision(size_t tile, TileAdjacency::Direction dir, size_t match, bool include)
+{
+  if (!m_journal.is_open())
+    return;
+
+  Writer writer(m_journal);
+  writer.start_list("decision");
+  write_id(writer, "tile", g_selected_tiles[tile].id);
+  writer.write("dir", static_cast<int>(dir));
+  write_id(writer, "match", g_selected_tiles[match].id);
+  writer.write("include", include);
+  writer.end_list("decision");
+
+  end_entry();
+}
+
+void
+Session::restore()
+{
+  std::ifstream in(m_filename, std::ios::binary);
+  if (!in.good())
+    return;
+
+  // The snapshot and the journal entries are siblings; wrap them so that
+  // the whole file is read in a single pass.
+  std::stringstream text;
+  text << "(st-tilemanager-session\n" << in.rdbuf() << "\n)";
+  const ReaderDocument doc = ReaderDocument::from_stream(text, m_filename);
+
+  std::unordered_map<uint32_t, size_t> indices;
+  bool have_snapshot = false;
+
+  auto iter = doc.get_root().get_mapping().get_iter();
+  while (iter.next())
+  {
+    const std::string key = iter.get_key();
+    const ReaderMapping entry = iter.as_mapping();
+
+    if (key == "snapshot")
+    {
+      int version = 0;
+      entry.get("version", version);
+      if (version != VERSION)
+        throw std::runtime_error("unsupported session version " + std::to_string(version));
+
+      std::vector<unsigned int> tile_runs, masks, decisions;
+      int adjacency_size = 0;
+      entry.get("step", m_step, "selection");
+      entry.get("tiles", tile_runs);
+      entry.get("masks", masks);
+      entry.get("adjacency-size", adjacency_size);
+      entry.get("decisions", decisions);
+
+      // No selection can hold more ids than the tileset has room for
+      const size_t max_ids = g_tile_index.size() == 0 ? 0 :
+        static_cast<size_t>(g_tile_index.get_max_id() - g_tile_index.get_min_id()) + 1;
+      const std::vector<uint32_t> ids = decode_ids(tile_runs, max_ids);
+      std::vector<SelectedTile> tiles(ids.size());
+      std::vector<bool> missing(ids.size(), false);
+
+      size_t index = 0;
+      for (size_t i = 0; i + 1 < masks.size(); i += 2)
+        for (unsigned int n = 0; n < masks[i + 1] && index < tiles.size(); ++n)
+          unpack_masks(masks[i], tiles[index++]);
+      if (index != tiles.size())
+        throw std::runtime_error("masks don't match the tiles");
+
+      for (size_t i = 0; i < ids.size(); ++i)
+      {
+        const TileHandle* handle = g_tile_index.find(ids[i]);
+        missing[i] = handle == nullptr;
+        tiles[i].handle = handle ? *handle : TileHandle{};
+        tiles[i].id = ids[i];
+      }
+
+      if (adjacency_size < 0 || static_cast<size_t>(adjacency_size) > ids.size())
+        throw std::runtime_error("decisions don't match the tiles");
+      const auto bits = decode_bits(decisions, TileAdjacency::get_bit_count(adjacency_size));
+
+      const uint32_t counts[2] = { static_cast<uint32_t>(ids.size()), static_cast<uint32_t>(adjacency_size) };
+      std::vector<uint8_t> state(sizeof(counts) + tiles.size() * sizeof(SelectedTile) + bits.size() * sizeof(uint64_t));
+      std::memcpy(state.data(), counts, sizeof(counts));
+      if (!tiles.empty())
+        std::memcpy(state.data() + sizeof(counts), tiles.data(), tiles.size() * sizeof(SelectedTile));
+      if (!bits.empty())
+        std::memcpy(state.data() + sizeof(counts) + tiles.size() * sizeof(SelectedTile), bits.data(),
+                    bits.size() * sizeof(uint64_t));
+      g_selected_tiles.load_state(state);
+
+      // Tiles that left the tileset take their decisions with them
+      for (size_t i = missing.size(); i-- > 0;)
+        if (missing[i])
+          g_selected_tiles.erase(i);
+
+      indices.clear();
+      for (size_t i = 0; i < g_selected_tiles.size(); ++i)
+        indices[g_selected_tiles[i].id] = i;
+      have_snapshot = true;
+    }
+    else if (!have_snapshot)
+    {
+      throw std::runtime_error("journal entry before the snapshot");
+    }
+    else if (key == "masks")
+    {
+      uint32_t id = 0, value = 0;
+      read_id(entry, "tile", id);
+      entry.get("value", value);
+
+      const auto it = indices.find(id);
+      if (it != indices.end())
+        unpack_masks(value, g_selected_tiles[it->second]);
+    }
+    else if (key == "decision")
+    {
+      uint32_t tile = 0, match = 0;
+      int dir = 0;
+      bool include = false;
+      read_id(entry, "tile", tile);
+      entry.get("dir", dir);
+      read_id(entry, "match", match);
+      entry.get("include", include);
+
+      const auto a = indices.find(tile);
+      const auto b = indices.find(match);
+      if (a == indices.end() || b == indices.end() || dir < 0 || dir >= TileAdjacency::NUM_DIRECTIONS)
+        continue;
+
+      // Decisions are only recorded once the pairing step sized the matrices
+      if (g_tile_adjacency.size() < g_selected_tiles.size())
+        g_tile_adjacency.resize(g_selected_tiles.size());
+
+      if (include)
+        g_tile_adjacency.include(a->second, static_cast<TileAdjacency::Direction>(dir), b->second);
+      else
+        g_tile_adjacency.exclude(a->second, static_cast<TileAdjacency::Direction>(dir), b->second);
+    }
+    else
+    {
+      log_warn << m_filename << ": unknown entry '" << key << "'" << std::endl;
+    }
+  }
+
+  log_info << "Restored session '" << m_filename << "': " << g_selected_tiles.size()
+           << " tile(s), at the " << m_step << " step" << std::endl;
+}
+
+void
+Session::open_journal()
+{
+  m_journal.open(m_filename, std::ios::out | std::ios::app);
+  m_journal_entries = 0;
+  if (!m_journal.good())
+    log_warn << "Couldn't open session '" << m_filename << "' for writing" << std::endl;
+}
+
+void
+Session::end_entry()
+{
+  m_journal.flush();
+  if (!m_journal.good())
+    log_warn << "Couldn't write to session '" << m_filename << "'" << std::endl;
+
+  if (++m_journal_entries >= COMPACT_AFTER)
+    save(m_step);
+}
+
+std::vector<unsigned int>
+Session::encode_ids(const std::vector<uint32_t>& ids)
+{
+  // Start and length pairs of runs of consecutive ids
+  std::vector<unsigned int> runs;
+  for (const uint32_t id : ids)
+  {
+    if (!runs.empty() && runs[runs.size() - 2] + runs.back() == id)
+      runs.back()++;
+    else
+      runs.insert(runs.end(), { id, 1u });
+  }
+  return runs;
+}
+
+std::vector<uint32_t>
+Session::decode_ids(const std::vector<unsigned int>& runs, size_t max_ids)
+{
+  if (runs.size() % 2 != 0)
+    throw std::runtime_error("tile list is truncated");
+
+  // Checked before expanding anything, so that a damaged run can't
+  // allocate its way to the limit
+  size_t count = 0;
+  for (size_t i = 0; i < runs.size(); i += 2)
+  {
+    if (runs[i + 1] > UINT32_MAX - runs[i])
+      throw std::runtime_error("tile run overflows");
+    count += runs[i + 1];
+    if (count > max_ids)
+      throw std::runtime_error("tile list is larger than the tileset");
+  }
+
+  std::vector<uint32_t> ids;
+  ids.reserve(count);
+  for (size_t i = 0; i < runs.size(); i += 2)
+    for (unsigned int n = 0; n < runs[i + 1]; ++n)
+      ids.push_back(runs[i] + n);
+  return ids;
+}
+
+std::vector<unsigned int>
+Session::encode_bits(const std::vector<uint64_t>& words)
+{
+  std::vector<unsigned int> runs;
+  bool value = false;
+  unsigned int run = 0;
+
+  for (const uint64_t word : words)
+  {
+    // Whole words that continue the current run are the common case
+    if (word == (value ? ~uint64_t(0) : 0))
+    {
+      run += 64;
+      continue;
+    }
+
+    for (int bit = 0; bit < 64; ++bit)
+    {
+      if (((word >> bit) & 1) != value)
+      {
+        runs.push_back(run);
+        value = !value;
+        run = 0;
+      }
+      run++;
+    }
+  }
+
+  runs.push_back(run);
+  return runs;
+}
+
+std::vector<uint64_t>
+Session::decode_bits(const std::vector<unsigned int>& runs, size_t word_count)
+{
+  std::vector<uint64_t> words(word_count, 0);
+  const size_t total = word_count * 64;
+
+  size_t pos = 0;
+  bool value = false;
+  for (const unsigned int run : runs)
+  {
+    if (run > total - pos)
+      throw std::runtime_error("decisions are corrupt");
+
+    if (value)
+      for (size_t i = pos; i < pos + run; ++i)
+        words[i / 64] |= uint64_t(1) << (i % 64);
+
+    pos += run;
+    value = !value;
+  }
+
+  if (pos != total)
+    throw std::runtime_error("decisions are truncated");
+  return words;
+}
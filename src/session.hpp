@@ -0,0 +1,86 @@
+//  SuperTux Tile Manager - A utility for SuperTux to manage tiles
+//  Copyright (C) 2021 Semphris <semphris@protonmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef _HEADER_STTILEMAN_SESSION_HPP
+#define _HEADER_STTILEMAN_SESSION_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "tile_adjacency.hpp"
+
+/** Keeps the work done on a tileset in a file next to it, so that it
+    can be picked up again later. The file starts with a snapshot of the
+    selection, the masks and the pairing decisions, written with Writer;
+    changes made afterwards are appended to it one entry at a time, and
+    folded into a new snapshot every so often. Tiles are referred to by
+    id, so that the session survives the tileset being edited. */
+class Session final
+{
+public:
+  /** Journal entries after which the file is rewritten from scratch */
+  static const size_t COMPACT_AFTER = 4096;
+
+  static std::string get_filename(const std::string& tileset);
+
+public:
+  Session();
+
+  /** Starts saving to the session of tileset, replacing any open one.
+      Restores what that session held and returns the step it was at
+      ("selection", "masks" or "pairings"), or "selection" if there was
+      no session yet. */
+  std::string open(const std::string& tileset);
+  void close();
+  bool is_open() const { return !m_filename.empty(); }
+
+  /** Rewrites the file with everything held in memory */
+  void save(const std::string& step);
+
+  void record_masks(size_t index);
+  void record_decision(size_t tile, TileAdjacency::Direction dir, size_t match, bool include);
+
+private:
+  void restore();
+  void open_journal();
+  /** Flushes an entry that was just written and compacts if needed */
+  void end_entry();
+
+  static std::vector<unsigned int> encode_ids(const std::vector<uint32_t>& ids);
+  /** Throws if a run overflows or the runs hold more than max_ids ids */
+  static std::vector<uint32_t> decode_ids(const std::vector<unsigned int>& runs, size_t max_ids);
+  /** Lengths of alternating runs of clear and set bits, clear first */
+  static std::vector<unsigned int> encode_bits(const std::vector<uint64_t>& words);
+  static std::vector<uint64_t> decode_bits(const std::vector<unsigned int>& runs, size_t word_count);
+
+private:
+  std::string m_filename;
+  std::string m_step;
+  std::ofstream m_journal;
+  size_t m_journal_entries;
+
+private:
+  Session(const Session&) = delete;
+  Session& operator=(const Session&) = delete;
+};
+
+extern Session g_session;
+
+#endif
@@ -17,33 +17,291 @@
 
 #include "supertux/tile_set_parser.hpp"
 
+#include <chrono>
 #include <sstream>
+#include <unordered_map>
 #include <sexp/value.hpp>
 #include <sexp/io.hpp>
 
 #include "util/log.hpp"
 #include "util/vector.hpp"
-#include "video/texture.hpp"
-#include "video/window.hpp"
 
+#include "image_cache.hpp"
+#include "mapped_file.hpp"
+#include "parallel.hpp"
+#include "tile_id_index.hpp"
+#include "tile_set_cache.hpp"
 #include "supertux/util/reader_document.hpp"
 #include "supertux/util/reader_mapping.hpp"
 #include "supertux/util/file_system.hpp"
 
-TileSetParser::TileSetParser(std::vector<TileGroup>& tilegroups, const std::string& filename, Window& window) :
-  m_window(window),
+namespace {
+
+/** Structural hash of a (tiles ...) block, used to find out which blocks
+    changed between two versions of a file */
+uint64_t hash_sexp(const sexp::Value& sx, uint64_t hash = TileSetCache::hash({}))
+{
+  auto feed = [&hash](const void* data, size_t size) {
+    hash = TileSetCache::hash(std::string_view(static_cast<const char*>(data), size), hash);
+  };
+
+  if (sx.is_array())
+  {
+    const auto& arr = sx.as_array();
+    const uint64_t size = arr.size();
+    feed("(", 1);
+    feed(&size, sizeof(size));
+    for (const auto& item : arr)
+      hash = hash_sexp(item, hash);
+  }
+  else if (sx.is_integer())
+  {
+    const int value = sx.as_int();
+    feed("i", 1);
+    feed(&value, sizeof(value));
+  }
+  else if (sx.is_real())
+  {
+    const float value = sx.as_float();
+    feed("r", 1);
+    feed(&value, sizeof(value));
+  }
+  else if (sx.is_boolean())
+  {
+    feed(sx.as_bool() ? "t" : "f", 1);
+  }
+  else if (sx.is_string() || sx.is_symbol())
+  {
+    const std::string& str = sx.as_string();
+    feed(sx.is_string() ? "s" : "y", 1);
+    feed(str.data(), str.size());
+    feed("", 1);
+  }
+  return hash;
+}
+
+double elapsed_ms(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+TileSetParser::Diagnostics::Diagnostics() :
+  errors(),
+  parse_ms(0.0),
+  images_ms(0.0)
+{
+}
+
+TileSetParser::PendingTileGroup::PendingTileGroup() :
+  skip(true),
+  line(0),
+  hash(0),
+  reuse(nullptr),
+  file(),
+  texture(),
+  width(0),
+  height(0),
+  ids(),
+  region(),
+  tiles(),
+  errors(),
+  warnings()
+{
+}
+
+TileSetParser::TileSetParser(std::vector<TileGroup>& tilegroups, const std::string& filename) :
   m_tilegroups(tilegroups),
   m_filename(filename),
-  m_tiles_path()
+  m_tiles_path(),
+  m_diagnostics(nullptr),
+  m_index(nullptr)
 {
 }
 
 void
-TileSetParser::parse()
+TileSetParser::parse(std::vector<TileGroup>* previous)
 {
   m_tiles_path = FileSystem::dirname(m_filename);
 
-  auto doc = ReaderDocument::from_file(m_filename);
+  // Imports only read image headers; the counters cover the decodes
+  // done for whatever tileset was imported last.
+  if (!m_diagnostics)
+    g_image_cache.reset_stats();
+
+  const auto parse_start = std::chrono::steady_clock::now();
+
+  auto file = std::make_shared<const MappedFile>(m_filename);
+  const uint64_t hash = TileSetCache::hash(file->view());
+
+  std::vector<PendingTileGroup> groups;
+  std::vector<TileSetCache::Group> cached;
+  std::optional<ReaderDocument> doc;
+  std::vector<ReaderMapping> blocks;
+
+  const bool from_cache = !m_diagnostics && TileSetCache::load(m_filename, hash, cached);
+  if (from_cache)
+  {
+    log_debug << "Loading " << m_filename << " from " << TileSetCache::get_filename(m_filename) << std::endl;
+
+    groups.resize(cached.size());
+    for (size_t i = 0; i < cached.size(); ++i)
+    {
+      groups[i].skip = false;
+      groups[i].hash = cached[i].hash;
+      groups[i].file = std::move(cached[i].file);
+      groups[i].width = cached[i].width;
+      groups[i].height = cached[i].height;
+      groups[i].region = cached[i].region;
+      groups[i].ids = std::move(cached[i].ids);
+    }
+    cached.clear();
+  }
+  else
+  {
+    doc.emplace(ReaderDocument::from_mapped_file(file));
+    collect_blocks(*doc, blocks);
+
+    groups.resize(blocks.size());
+    parallel_for(blocks.size(), [&](size_t i) {
+      groups[i].hash = hash_sexp(blocks[i].get_sexp());
+      groups[i].line = blocks[i].get_sexp().get_line();
+    });
+  }
+
+  if (previous)
+    reuse_groups(*previous, groups);
+
+  // Validate all blocks in parallel; the first error in file order wins.
+  parallel_for(blocks.size(), [&](size_t i) {
+    if (groups[i].reuse)
+      return;
+
+    if (!m_diagnostics)
+    {
+      parse_tiles(blocks[i], groups[i]);
+      return;
+    }
+
+    try
+    {
+      parse_tiles(blocks[i], groups[i]);
+    }
+    catch (const std::exception& e)
+    {
+      groups[i].errors.push_back(e.what());
+      groups[i].skip = true;
+    }
+  });
+
+  if (m_diagnostics)
+    m_diagnostics->parse_ms = elapsed_ms(parse_start);
+  const auto images_start = std::chrono::steady_clock::now();
+
+  // Only the image headers are needed here; textures are uploaded once
+  // a group is actually looked at.
+  parallel_for(groups.size(), [&](size_t i) {
+    auto& group = groups[i];
+    if (group.skip || group.reuse)
+      return;
+
+    if (!m_diagnostics)
+    {
+      group.texture = LazyTexture(FileSystem::join(m_tiles_path, group.file));
+      create_tiles(group, group.texture.get_size());
+      return;
+    }
+
+    try
+    {
+      group.texture = LazyTexture(FileSystem::join(m_tiles_path, group.file));
+    }
+    catch (const std::exception& e)
+    {
+      group.errors.push_back(e.what());
+      group.skip = true;
+      return;
+    }
+    create_tiles(group, group.texture.get_size());
+  });
+
+  // The workers only collect their warnings, so that lines from
+  // different blocks don't interleave.
+  for (const auto& group : groups)
+  {
+    for (const auto& warning : group.warnings)
+      log_warn << warning << std::endl;
+  }
+
+  if (m_diagnostics)
+  {
+    m_diagnostics->images_ms = elapsed_ms(images_start);
+
+    for (size_t i = 0; i < groups.size(); ++i)
+    {
+      for (const auto& error : groups[i].errors)
+      {
+        std::ostringstream out;
+        out << "block " << (i + 1) << " (line " << groups[i].line << "): " << error;
+        m_diagnostics->errors.push_back(out.str());
+      }
+    }
+  }
+  else if (!from_cache)
+  {
+    for (const auto& group : groups)
+    {
+      if (group.reuse)
+      {
+        const TileGroup& tilegroup = *group.reuse;
+        cached.push_back({ tilegroup.hash, tilegroup.file, tilegroup.width, tilegroup.height,
+                           tilegroup.region, tilegroup.tiles.get_ids() });
+      }
+      else if (!group.skip)
+      {
+        cached.push_back({ group.hash, group.file, group.width, group.height, *group.region, group.ids });
+      }
+    }
+    TileSetCache::save(m_filename, hash, cached);
+  }
+
+  // Append on this thread to keep the groups in file order.
+  for (auto& group : groups)
+  {
+    if (group.reuse)
+    {
+      m_tilegroups.push_back(std::move(*group.reuse));
+    }
+    else if (!group.skip)
+    {
+      m_tilegroups.push_back(TileGroup(group.file, group.hash, group.width, group.height,
+                                       std::move(group.tiles), group.texture, *group.region));
+    }
+  }
+
+  TileIdIndex local_index;
+  TileIdIndex& index = m_index ? *m_index : local_index;
+  std::vector<TileIdIndex::Duplicate> duplicates;
+  index.build(m_tilegroups, &duplicates);
+
+  for (const auto& duplicate : duplicates)
+  {
+    std::ostringstream err;
+    err << "Duplicate tile id " << duplicate.id << ": '" << m_tilegroups[duplicate.first.group].file
+        << "' tile " << duplicate.first.index << " and '" << m_tilegroups[duplicate.second.group].file
+        << "' tile " << duplicate.second.index;
+
+    if (m_diagnostics)
+      m_diagnostics->errors.push_back(err.str());
+    else
+      log_warn << err.str() << std::endl;
+  }
+}
+
+void
+TileSetParser::collect_blocks(const ReaderDocument& doc, std::vector<ReaderMapping>& blocks) const
+{
   auto root = doc.get_root();
 
   if (root.get_name() != "supertux-tiles")
@@ -51,22 +309,40 @@ TileSetParser::parse()
 
   auto iter = root.get_mapping().get_iter();
   while (iter.next())
-  {  
+  {
     if (iter.get_key() == "tiles")
-    {
-      ReaderMapping tiles_mapping = iter.as_mapping();
-      parse_tiles(tiles_mapping);
-    }
+      blocks.push_back(iter.as_mapping());
   }
 }
 
 void
-TileSetParser::parse_tiles(const ReaderMapping& reader)
+TileSetParser::reuse_groups(std::vector<TileGroup>& previous, std::vector<PendingTileGroup>& groups) const
+{
+  std::unordered_multimap<uint64_t, TileGroup*> candidates;
+  for (auto& tilegroup : previous)
+  {
+    if (tilegroup.texture.is_current())
+      candidates.emplace(tilegroup.hash, &tilegroup);
+  }
+
+  // Identical blocks may appear more than once; each old group is only
+  // handed out once.
+  for (auto& group : groups)
+  {
+    auto it = candidates.find(group.hash);
+    if (it == candidates.end())
+      continue;
+
+    group.reuse = it->second;
+    candidates.erase(it);
+  }
+}
+
+void
+TileSetParser::parse_tiles(const ReaderMapping& reader, PendingTileGroup& group) const
 {
   // List of ids (use 0 if the tile should be ignored)
-  std::vector<uint32_t> ids;
-  // List of tile objects
-  std::vector<Tile> tiles;
+  std::vector<uint32_t>& ids = group.ids;
 
   // width and height of the image in tile units, this is used for two
   // purposes:
@@ -114,48 +390,86 @@ TileSetParser::parse_tiles(const ReaderMapping& reader)
   }
   else
   {
-    Texture* texture;
-    std::string file;
-    Rect region;
     std::optional<ReaderMapping> textures_mapping;
-    if (reader.get("image", textures_mapping) ||
-        reader.get("images", textures_mapping))
-      texture = parse_imagespecs(*textures_mapping, file, region);
+    if (!reader.get("image", textures_mapping) &&
+        !reader.get("images", textures_mapping))
+      return;
 
-    if (!texture)
+    if (!parse_imagespecs(*textures_mapping, group.file, group.region, group.warnings))
       return;
 
-    // Region should not exceed texture size
-    region.x2 = region.x1 + std::min(region.width(), texture->get_size().w - region.x1);
-    region.y2 = region.y1 + std::min(region.height(), texture->get_size().h - region.y1);
+    for (auto& id : ids)
+      id += offset;
 
-    // Tilegroup size should allow for maximum possible 32x32 squares in region.
-    // Region size should not exceed provided tilegroup size.
-    while (region.width() + 32.f < static_cast<float>(width) * 32.f && width > 0)
-      width--;
-    region.x2 = region.x1 + static_cast<float>(width) * 32.f;
+    group.width = width;
+    group.height = height;
+    group.skip = false;
+  }
+}
 
-    while (region.height() + 32.f < static_cast<float>(height) * 32.f && height > 0)
-      height--;
-    region.y2 = region.y1 + static_cast<float>(height) * 32.f;
+void
+TileSetParser::create_tiles(PendingTileGroup& group, const Size& image_size) const
+{
+  Rect region = group.region.value_or(Rect(Vector(0.f, 0.f), image_size));
+  unsigned int width = group.width;
+  unsigned int height = group.height;
 
-    // Create tiles from IDs
-    for (size_t i = 0; i < ids.size(); ++i)
+  if (m_diagnostics)
+  {
+    std::ostringstream err;
+    if (region.x1 < 0.f || region.y1 < 0.f ||
+        region.x2 > image_size.w || region.y2 > image_size.h)
     {
-      ids[i] += offset;
-
-      const Vector pos = Vector(i % width, i / width) * 32.f + region.top_lft();
-      tiles.push_back(Tile(ids[i], Rect(pos, Size(32.f, 32.f))));
+      err << "Region (" << region.x1 << " " << region.y1 << " " << region.width() << " "
+          << region.height() << ") exceeds image '" << group.file << "' ("
+          << image_size.w << "x" << image_size.h << ")";
+    }
+    else if (region.width() < static_cast<float>(width) * 32.f ||
+             region.height() < static_cast<float>(height) * 32.f)
+    {
+      err << "Region of image '" << group.file << "' (" << region.width() << "x"
+          << region.height() << ") is too small for " << width << "x" << height << " tiles";
+    }
+    if (!err.str().empty())
+    {
+      group.errors.push_back(err.str());
+      group.skip = true;
+      return;
     }
+  }
+
+  // Region should not exceed texture size
+  region.x2 = region.x1 + std::min(region.width(), image_size.w - region.x1);
+  region.y2 = region.y1 + std::min(region.height(), image_size.h - region.y1);
+
+  // Tilegroup size should allow for maximum possible 32x32 squares in region.
+  // Region size should not exceed provided tilegroup size.
+  while (region.width() + 32.f < static_cast<float>(width) * 32.f && width > 0)
+    width--;
+  region.x2 = region.x1 + static_cast<float>(width) * 32.f;
 
-    m_tilegroups.push_back(TileGroup(FileSystem::basename(file), width, height,
-                                     std::move(tiles), texture, region));
+  while (region.height() + 32.f < static_cast<float>(height) * 32.f && height > 0)
+    height--;
+  region.y2 = region.y1 + static_cast<float>(height) * 32.f;
+
+  if (width == 0 || height == 0)
+  {
+    group.warnings.push_back("Region of image '" + group.file + "' holds no tiles, skipping it");
+    group.skip = true;
+    return;
   }
+
+  // Create tiles from IDs
+  group.tiles = TileStore(region.top_lft(), width, group.ids);
+
+  group.width = width;
+  group.height = height;
+  group.region = region;
 }
 
-Texture*
-TileSetParser::parse_imagespecs(const ReaderMapping& images_mapping,
-                                std::string& file, Rect& region) const
+bool
+TileSetParser::parse_imagespecs(const ReaderMapping& images_mapping, std::string& file,
+                                std::optional<Rect>& region, std::vector<std::string>& warnings) const
 {
   // (images "foo.png" "foo.bar" ...)
   // (images (region "foo.png" 0 0 32 32))
@@ -164,14 +478,14 @@ TileSetParser::parse_imagespecs(const ReaderMapping& images_mapping,
   {
     if (iter.is_string())
     {
+      // The region covers the whole image, whose size isn't known yet
       file = iter.as_string_item();
-      Texture& texture = m_window.load_texture(FileSystem::join(m_tiles_path, file));
-      region = Rect(Vector(0.f, 0.f), texture.get_size());
-      return &texture;
+      region.reset();
+      return true;
     }
     else if (iter.is_pair() && iter.get_key() == "surface")
     {
-      log_warn << "Surfaces are not supported." << std::endl;
+      warnings.push_back("Surfaces are not supported.");
     }
     else if (iter.is_pair() && iter.get_key() == "region")
     {
@@ -179,7 +493,9 @@ TileSetParser::parse_imagespecs(const ReaderMapping& images_mapping,
       auto const& arr = sx.as_array();
       if (arr.size() != 6)
       {
-        log_warn << "(region X Y WIDTH HEIGHT) tag malformed: " << sx << std::endl;
+        std::ostringstream warning;
+        warning << "(region X Y WIDTH HEIGHT) tag malformed: " << sx;
+        warnings.push_back(warning.str());
       }
       else
       {
@@ -190,15 +506,15 @@ TileSetParser::parse_imagespecs(const ReaderMapping& images_mapping,
         const int h = arr[5].as_int();
 
         region = Rect(Vector(x, y), Size(w, h));
-        return &m_window.load_texture(FileSystem::join(m_tiles_path, file));
+        return true;
       }
     }
     else
     {
-      log_warn << "Expected string or list in images tag" << std::endl;
+      warnings.push_back("Expected string or list in images tag");
     }
   }
-  return nullptr;
+  return false;
 }
 
 /* EOF */
@@ -18,33 +18,82 @@
 #ifndef HEADER_SUPERTUX_SUPERTUX_TILE_SET_PARSER_HPP
 #define HEADER_SUPERTUX_SUPERTUX_TILE_SET_PARSER_HPP
 
+#include <optional>
 #include <string>
 #include <vector>
 
+#include "lazy_texture.hpp"
 #include "tile.hpp"
 #include "util/rect.hpp"
 
+class ReaderDocument;
 class ReaderMapping;
-class Texture;
-class Window;
+class TileIdIndex;
 
 class TileSetParser final
 {
+public:
+  /** What a validation run found in a file, and where the time went */
+  struct Diagnostics
+  {
+    Diagnostics();
+
+    std::vector<std::string> errors;
+    double parse_ms;
+    double images_ms;
+  };
+
+private:
+  /** One (tiles ...) block on its way through the import pipeline */
+  struct PendingTileGroup
+  {
+    PendingTileGroup();
+
+    bool skip;
+    int line;
+    uint64_t hash;
+    TileGroup* reuse;
+    std::string file;
+    LazyTexture texture;
+    unsigned int width;
+    unsigned int height;
+    std::vector<uint32_t> ids;
+    std::optional<Rect> region;
+    TileStore tiles;
+    std::vector<std::string> errors;
+    std::vector<std::string> warnings; // Logged on the calling thread
+  };
+
 private:
-  Window& m_window;
   std::vector<TileGroup>& m_tilegroups;
   std::string m_filename;
   std::string m_tiles_path;
+  Diagnostics* m_diagnostics;
+  TileIdIndex* m_index;
 
 public:
-  TileSetParser(std::vector<TileGroup>& tilegroups, const std::string& filename, Window& window);
+  TileSetParser(std::vector<TileGroup>& tilegroups, const std::string& filename);
+
+  /** If previous groups are given, those whose (tiles ...) block and
+      image did not change are moved over instead of being parsed again. */
+  void parse(std::vector<TileGroup>* previous = nullptr);
+
+  /** In validation mode, every block is checked even after an error,
+      errors are recorded instead of thrown, regions are checked against
+      the image sizes and the sidecar cache is neither read nor written. */
+  void set_diagnostics(Diagnostics* diagnostics) { m_diagnostics = diagnostics; }
 
-  void parse();
+  /** The index to fill with the ids of the parsed groups. Duplicate
+      ids are reported either way. */
+  void set_index(TileIdIndex* index) { m_index = index; }
 
 private:
-  void parse_tiles(const ReaderMapping& reader);
-  Texture* parse_imagespecs(const ReaderMapping& images_mapping,
-                            std::string& file, Rect& region) const;
+  void collect_blocks(const ReaderDocument& doc, std::vector<ReaderMapping>& blocks) const;
+  void reuse_groups(std::vector<TileGroup>& previous, std::vector<PendingTileGroup>& groups) const;
+  void parse_tiles(const ReaderMapping& reader, PendingTileGroup& group) const;
+  bool parse_imagespecs(const ReaderMapping& images_mapping, std::string& file,
+                        std::optional<Rect>& region, std::vector<std::string>& warnings) const;
+  void create_tiles(PendingTileGroup& group, const Size& image_size) const;
 
 private:
   TileSetParser(const TileSetParser&) = delete;
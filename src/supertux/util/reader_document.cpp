@@ -22,8 +22,25 @@
 
 #include "util/log.hpp"
 
+#include "mapped_file.hpp"
 #include "supertux/util/file_system.hpp"
 
+namespace {
+
+/** Read-only streambuf over memory owned by someone else; lets the
+    sexp lexer pull its input directly out of a MappedFile. */
+class MemoryStreamBuf final : public std::streambuf
+{
+public:
+  MemoryStreamBuf(const char* data, size_t size)
+  {
+    char* begin = const_cast<char*>(data);
+    setg(begin, begin, begin + size);
+  }
+};
+
+} // namespace
+
 ReaderDocument
 ReaderDocument::from_stream(std::istream& stream, const std::string& filename)
 {
@@ -52,9 +69,30 @@ ReaderDocument::from_file(const std::string& filename)
   }
 }
 
+ReaderDocument
+ReaderDocument::from_mapped_file(const std::string& filename)
+{
+  return from_mapped_file(std::make_shared<const MappedFile>(filename));
+}
+
+ReaderDocument
+ReaderDocument::from_mapped_file(std::shared_ptr<const MappedFile> mapping)
+{
+  const std::string& filename = mapping->get_filename();
+  log_debug << "ReaderDocument::parse (mapped): " << filename << std::endl;
+
+  MemoryStreamBuf buf(mapping->data(), mapping->size());
+  std::istream in(&buf);
+
+  ReaderDocument doc = from_stream(in, filename);
+  doc.m_mapping = std::move(mapping);
+  return doc;
+}
+
 ReaderDocument::ReaderDocument(const std::string& filename, sexp::Value sx) :
   m_filename(filename),
-  m_sx(std::move(sx))
+  m_sx(std::move(sx)),
+  m_mapping()
 {
 }
 
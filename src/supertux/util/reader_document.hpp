@@ -18,10 +18,13 @@
 #define HEADER_SUPERTUX_UTIL_READER_DOCUMENT_HPP
 
 #include <istream>
+#include <memory>
 #include <sexp/value.hpp>
 
 #include "supertux/util/reader_object.hpp"
 
+class MappedFile;
+
 /** The ReaderDocument holds a parsed document in memory, access to
     it's content is provided by get_root() */
 class ReaderDocument final
@@ -30,6 +33,12 @@ public:
   static ReaderDocument from_stream(std::istream& stream, const std::string& filename = "<stream>");
   static ReaderDocument from_file(const std::string& filename);
 
+  /** Maps the file into memory and tokenizes straight from the
+      mapping instead of going through an std::ifstream. The mapping is
+      kept alive for as long as the document. */
+  static ReaderDocument from_mapped_file(const std::string& filename);
+  static ReaderDocument from_mapped_file(std::shared_ptr<const MappedFile> mapping);
+
 public:
   ReaderDocument(const std::string& filename, sexp::Value sx);
 
@@ -44,9 +53,14 @@ public:
 
   const sexp::Value& get_sexp() const { return m_sx; }
 
+  /** Returns the raw file contents if the document was created by
+      from_mapped_file(), nullptr otherwise */
+  const MappedFile* get_mapping() const { return m_mapping.get(); }
+
 private:
   std::string m_filename;
   sexp::Value m_sx;
+  std::shared_ptr<const MappedFile> m_mapping;
 };
 
 #endif
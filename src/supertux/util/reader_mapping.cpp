@@ -185,7 +185,31 @@ ReaderMapping::get(const char* key, std::vector<unsigned int>& value,
                    const std::optional<std::vector<unsigned int>>& default_value) const
 {
   value.clear();
-  GET_VALUES_MACRO("unsigned int", is_integer, as_int)
+
+  // Not using GET_VALUES_MACRO: (ids ...) lists are the bulk of every
+  // tileset, so size the buffer once and store straight into it.
+  auto const sx = get_item(key);
+  if (!sx) {
+    if (default_value) {
+      value = *default_value;
+    }
+    return false;
+  } else {
+    assert_is_array(m_doc, *sx);
+    auto const& item = sx->as_array();
+    value.resize(item.size() - 1);
+
+    unsigned int* out = value.data();
+    for (auto it = item.begin() + 1; it != item.end(); ++it, ++out)
+    {
+      if (!it->is_integer()) {
+        value.clear();
+        raise_exception(m_doc, *it, "expected integer");
+      }
+      *out = static_cast<unsigned int>(it->as_int());
+    }
+    return true;
+  }
 }
 
 #undef GET_VALUES_MACRO
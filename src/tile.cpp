@@ -17,30 +17,223 @@
 
 #include "tile.hpp"
 
+#include <cstring>
+#include <stdexcept>
+
+#include "supertux/util/file_system.hpp"
+#include "tile_adjacency.hpp"
+#include "tile_id_index.hpp"
+
 std::vector<TileGroup> g_tilegroups = {};
 TileGroup* g_tilegroup = nullptr;
 
-std::vector<Tile> g_selected_tiles = {};
+TileSelection g_selected_tiles;
 
-
-Tile::Tile(uint32_t id_, const Rect& src_rect) :
-  id(id_),
-  srcrect(src_rect),
-  mask_up(1),
-  mask_left(1),
-  mask_down(1),
-  mask_right(1),
-  non_solid(false)
+TileStore::TileStore() :
+  m_origin(),
+  m_ids(),
+  m_cells()
 {}
 
-TileGroup::TileGroup(const std::string& filename_,
+TileStore::TileStore(const Vector& origin, unsigned int width, const std::vector<uint32_t>& ids) :
+  m_origin(origin),
+  m_ids(ids),
+  m_cells(ids.size())
+{
+  for (size_t i = 0; i < ids.size(); ++i)
+  {
+    const auto column = static_cast<uint32_t>(i % width);
+    const auto row = static_cast<uint32_t>(i / width);
+    m_cells[i] = column | (row << 16);
+  }
+}
+
+Rect
+TileStore::get_srcrect(size_t index) const
+{
+  const uint32_t cell = m_cells[index];
+  const Vector pos = Vector(cell & 0xffff, cell >> 16) * 32.f + m_origin;
+  return Rect(pos, Size(32.f, 32.f));
+}
+
+size_t
+TileStore::get_memory_usage() const
+{
+  return m_ids.capacity() * sizeof(uint32_t) + m_cells.capacity() * sizeof(uint32_t);
+}
+
+TileGroup::TileGroup(const std::string& file_, uint64_t hash_,
                      unsigned int w, unsigned int h,
-                     std::vector<Tile> tiles_, Texture* texture_,
+                     TileStore tiles_, const LazyTexture& texture_,
                      const Rect& region_) :
-  filename(filename_),
+  filename(FileSystem::basename(file_)),
+  file(file_),
+  hash(hash_),
   width(w),
   height(h),
   tiles(std::move(tiles_)),
   texture(texture_),
   region(region_)
 {}
+
+TileSelection::TileSelection() :
+  m_tiles(),
+  m_ids(),
+  m_id_base(0),
+  m_sparse_ids(),
+  m_revision(0)
+{}
+
+bool
+TileSelection::add(const TileHandle& handle)
+{
+  if (!add_tile(handle))
+    return false;
+
+  m_revision++;
+  return true;
+}
+
+size_t
+TileSelection::add(const std::vector<TileHandle>& handles)
+{
+  const size_t old_size = m_tiles.size();
+  m_tiles.reserve(old_size + handles.size());
+
+  for (const auto& handle : handles)
+    add_tile(handle);
+
+  if (m_tiles.size() != old_size)
+    m_revision++;
+
+  return m_tiles.size() - old_size;
+}
+
+bool
+TileSelection::add_tile(const TileHandle& handle)
+{
+  const TileStore& store = g_tilegroups.at(handle.group).tiles;
+  const uint32_t id = store.get_ids().at(handle.index);
+  if (id == 0 || contains(id))
+    return false;
+
+  SelectedTile tile = {};
+  tile.handle = handle;
+  tile.id = id;
+  tile.mask_up = 1;
+  tile.mask_left = 1;
+  tile.mask_down = 1;
+  tile.mask_right = 1;
+  tile.non_solid = 0;
+
+  m_tiles.push_back(tile);
+  set_id(id, true);
+  return true;
+}
+
+void
+TileSelection::erase(size_t index)
+{
+  set_id(m_tiles[index].id, false);
+  m_tiles.erase(m_tiles.begin() + index);
+  g_tile_adjacency.erase(index);
+  m_revision++;
+}
+
+void
+TileSelection::clear()
+{
+  m_tiles.clear();
+  m_ids.clear();
+  m_sparse_ids.clear();
+  g_tile_adjacency.clear();
+  m_revision++;
+}
+
+bool
+TileSelection::contains(uint32_t id) const
+{
+  const uint32_t bit = id - m_id_base;
+  if (id >= m_id_base && bit / 64 < m_ids.size())
+    return (m_ids[bit / 64] >> (bit % 64)) & 1;
+
+  return m_sparse_ids.count(id) != 0;
+}
+
+void
+TileSelection::set_id(uint32_t id, bool selected)
+{
+  if (m_ids.empty() && m_sparse_ids.empty() && g_tile_index.is_dense() && g_tile_index.size() > 0)
+  {
+    m_id_base = g_tile_index.get_min_id();
+    m_ids.assign((g_tile_index.get_max_id() - m_id_base) / 64 + 1, 0);
+  }
+
+  const uint32_t bit = id - m_id_base;
+  if (id >= m_id_base && bit / 64 < m_ids.size())
+  {
+    if (selected)
+      m_ids[bit / 64] |= uint64_t(1) << (bit % 64);
+    else
+      m_ids[bit / 64] &= ~(uint64_t(1) << (bit % 64));
+  }
+  else if (selected)
+  {
+    m_sparse_ids.insert(id);
+  }
+  else
+  {
+    m_sparse_ids.erase(id);
+  }
+}
+
+Rect
+TileSelection::get_srcrect(size_t index) const
+{
+  const TileHandle& handle = m_tiles[index].handle;
+  return g_tilegroups[handle.group].tiles.get_srcrect(handle.index);
+}
+
+void
+TileSelection::save_state(std::vector<uint8_t>& state) const
+{
+  const uint32_t counts[2] = { static_cast<uint32_t>(m_tiles.size()),
+                               static_cast<uint32_t>(g_tile_adjacency.size()) };
+  const size_t tiles_size = counts[0] * sizeof(SelectedTile);
+  const size_t bits_size = g_tile_adjacency.get_bit_count() * sizeof(uint64_t);
+
+  state.resize(sizeof(counts) + tiles_size + bits_size);
+  std::memcpy(state.data(), counts, sizeof(counts));
+  std::memcpy(state.data() + sizeof(counts), m_tiles.data(), tiles_size);
+
+  std::vector<uint64_t> bits(g_tile_adjacency.get_bit_count());
+  g_tile_adjacency.save_bits(bits.data());
+  std::memcpy(state.data() + sizeof(counts) + tiles_size, bits.data(), bits_size);
+}
+
+void
+TileSelection::load_state(const std::vector<uint8_t>& state)
+{
+  uint32_t counts[2] = { 0, 0 };
+  if (state.size() < sizeof(counts))
+    throw std::runtime_error("Selection state is truncated");
+  std::memcpy(counts, state.data(), sizeof(counts));
+
+  const size_t tiles_size = counts[0] * sizeof(SelectedTile);
+  const size_t bits_size = TileAdjacency::get_bit_count(counts[1]) * sizeof(uint64_t);
+  if (counts[1] > counts[0] || state.size() != sizeof(counts) + tiles_size + bits_size)
+    throw std::runtime_error("Selection state is truncated");
+
+  m_tiles.resize(counts[0]);
+  std::memcpy(m_tiles.data(), state.data() + sizeof(counts), tiles_size);
+
+  m_ids.clear();
+  m_sparse_ids.clear();
+  for (const auto& tile : m_tiles)
+    set_id(tile.id, true);
+  m_revision++;
+
+  std::vector<uint64_t> bits(bits_size / sizeof(uint64_t));
+  std::memcpy(bits.data(), state.data() + sizeof(counts) + tiles_size, bits_size);
+  g_tile_adjacency.load_bits(counts[1], bits.data());
+}
@@ -18,60 +18,162 @@
 #ifndef _HEADER_STTILEMAN_TILE_HPP
 #define _HEADER_STTILEMAN_TILE_HPP
 
+#include <memory>
 #include <string>
+#include <type_traits>
+#include <unordered_set>
 #include <vector>
 #include <cstdint>
 
 #include "util/rect.hpp"
+#include "util/vector.hpp"
 
-class Texture;
+#include "lazy_texture.hpp"
 
-struct Tile
+/** Refers to a tile by position instead of by address, so that it
+    survives containers moving around and can be copied byte for byte. */
+struct TileHandle
 {
-  Tile(uint32_t id, const Rect& srcrect);
+  uint16_t group; //< Index into g_tilegroups
+  uint16_t unused;
+  uint32_t index; //< Index into TileGroup::tiles
+};
+
+/** A tile picked by the user, along with what they said about it */
+struct SelectedTile
+{
+  enum Flags : uint8_t
+  {
+    /** The masks were filled in from the pixels; later guesses don't
+        overwrite what the user changed since */
+    MASKS_GUESSED = 0x1
+  };
 
   // Step 1
+  TileHandle handle;
   uint32_t id;
-  Rect srcrect;
 
   // Step 2
-  short mask_up;
-  short mask_left;
-  short mask_down;
-  short mask_right;
-  bool non_solid;
-
-  // Step 3
-  std::vector<Tile*> in_up;
-  std::vector<Tile*> ex_up;
-  std::vector<Tile*> in_left;
-  std::vector<Tile*> ex_left;
-  std::vector<Tile*> in_down;
-  std::vector<Tile*> ex_down;
-  std::vector<Tile*> in_right;
-  std::vector<Tile*> ex_right;
+  uint8_t mask_up;
+  uint8_t mask_left;
+  uint8_t mask_down;
+  uint8_t mask_right;
+  uint8_t non_solid;
+  uint8_t flags;
+  uint8_t unused[2];
+
+  // Step 3 lives in g_tile_adjacency, indexed like g_selected_tiles
+};
+
+static_assert(std::is_trivially_copyable<SelectedTile>::value, "SelectedTile is snapshotted with memcpy");
+static_assert(sizeof(SelectedTile) == 20, "SelectedTile must not have hidden padding");
+
+/** The tiles of a group, stored one array per field so that scanning
+    one field only touches that field. Tiles sit on a grid of 32x32
+    cells; their rectangles are computed from the grid position. */
+class TileStore final
+{
+public:
+  TileStore();
+  /** Lays ids out row by row, width tiles per row, from origin */
+  TileStore(const Vector& origin, unsigned int width, const std::vector<uint32_t>& ids);
+
+  size_t size() const { return m_ids.size(); }
+  bool empty() const { return m_ids.empty(); }
+
+  const std::vector<uint32_t>& get_ids() const { return m_ids; }
+  Rect get_srcrect(size_t index) const;
+
+  /** Bytes held by the arrays */
+  size_t get_memory_usage() const;
+
+private:
+  Vector m_origin;
+  std::vector<uint32_t> m_ids;
+  /** Column in the low 16 bits, row in the high 16 bits */
+  std::vector<uint32_t> m_cells;
 };
 
 struct TileGroup
 {
-  TileGroup(const std::string& filename,
+  TileGroup(const std::string& file, uint64_t hash,
             unsigned int w, unsigned int h,
-            std::vector<Tile> tiles, Texture* texture,
+            TileStore tiles, const LazyTexture& texture,
             const Rect& region);
 
-  const std::string filename;
+  // Not const, so that unchanged groups can be moved over on reload
+  std::string filename;
+  std::string file;
+  uint64_t hash;
 
-  const unsigned int width;
-  const unsigned int height;
-  const std::vector<Tile> tiles;
+  unsigned int width;
+  unsigned int height;
+  TileStore tiles;
 
-  Texture* const texture;
-  const Rect region;
+  LazyTexture texture;
+  Rect region;
 };
 
 extern std::vector<TileGroup> g_tilegroups;
 extern TileGroup* g_tilegroup;
 
-extern std::vector<Tile> g_selected_tiles;
+/** The tiles picked in the first step. Erasing and clearing keep
+    g_tile_adjacency in step with the indices; it is only grown to
+    cover new tiles once the pairing step starts, as it takes n^2 bits. */
+class TileSelection final
+{
+public:
+  TileSelection();
+
+  size_t size() const { return m_tiles.size(); }
+  bool empty() const { return m_tiles.empty(); }
+
+  SelectedTile& operator[](size_t index) { return m_tiles[index]; }
+  const SelectedTile& operator[](size_t index) const { return m_tiles[index]; }
+
+  std::vector<SelectedTile>::const_iterator begin() const { return m_tiles.begin(); }
+  std::vector<SelectedTile>::const_iterator end() const { return m_tiles.end(); }
+
+  /** Tiles with id 0 or an id that is already selected are left out.
+      Returns whether the tile was added. */
+  bool add(const TileHandle& handle);
+  /** Same as above for several tiles. Returns how many tiles were added. */
+  size_t add(const std::vector<TileHandle>& handles);
+  void erase(size_t index);
+  void clear();
+
+  bool contains(uint32_t id) const;
+
+  /** Changes whenever tiles are added, erased or restored */
+  uint64_t get_revision() const { return m_revision; }
+
+  Rect get_srcrect(size_t index) const;
+
+  /** Copies the selection and its pairings into a flat buffer. Nothing
+      in it points anywhere, so it can be restored or written out as is. */
+  void save_state(std::vector<uint8_t>& state) const;
+  void load_state(const std::vector<uint8_t>& state);
+
+private:
+  bool add_tile(const TileHandle& handle);
+  void set_id(uint32_t id, bool selected);
+
+private:
+  std::vector<SelectedTile> m_tiles;
+  /** One bit per id of g_tile_index's range, starting at m_id_base, set
+      while that id is selected. Sized on the first selection after a
+      clear; ids outside of it, or all of them if the index is sparse,
+      go into m_sparse_ids. */
+  std::vector<uint64_t> m_ids;
+  uint32_t m_id_base;
+  std::unordered_set<uint32_t> m_sparse_ids;
+  uint64_t m_revision;
+
+private:
+  TileSelection(const TileSelection&) = delete;
+  TileSelection& operator=(const TileSelection&) = delete;
+};
+
+extern TileSelection g_selected_tiles;
 
 #endif
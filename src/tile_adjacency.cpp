@@ -0,0 +1,312 @@
+//  SuperTux Tile Manager - A utility for SuperTux to manage tiles
+//  Copyright (C) 2021 Semphris <semphris@protonmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "tile_adjacency.hpp"
+
+#include <algorithm>
+#include <bitset>
+
+TileAdjacency g_tile_adjacency;
+
+namespace {
+
+size_t words_for(size_t count)
+{
+  return (count + 63) / 64;
+}
+
+/** Removes bit index from a row, shifting every later bit down by one */
+void erase_bit(uint64_t* row, size_t words, size_t index)
+{
+  const size_t word = index / 64;
+  const uint64_t low_mask = (uint64_t(1) << (index % 64)) - 1;
+
+  uint64_t high = row[word] & ~low_mask;
+  high >>= 1;
+  if (word + 1 < words)
+    high |= row[word + 1] << 63;
+  row[word] = (row[word] & low_mask) | (high & ~low_mask);
+
+  for (size_t i = word + 1; i < words; ++i)
+    row[i] = (row[i] >> 1) | (i + 1 < words ? row[i + 1] << 63 : 0);
+}
+
+} // namespace
+
+TileAdjacency::Direction
+TileAdjacency::opposite(Direction dir)
+{
+  switch (dir)
+  {
+    case UP:
+      return DOWN;
+    case LEFT:
+      return RIGHT;
+    case DOWN:
+      return UP;
+    case RIGHT:
+      return LEFT;
+    default:
+      return dir;
+  }
+}
+
+size_t
+TileAdjacency::count(const Row& row)
+{
+  size_t total = 0;
+  for (const auto word : row)
+    total += std::bitset<64>(word).count();
+  return total;
+}
+
+size_t
+TileAdjacency::find_next(const Row& row, size_t index)
+{
+  size_t word = index / 64;
+  if (word >= row.size())
+    return npos;
+
+  uint64_t bits = row[word] & (~uint64_t(0) << (index % 64));
+  while (!bits)
+  {
+    if (++word >= row.size())
+      return npos;
+    bits = row[word];
+  }
+
+  size_t bit = 0;
+  while (!(bits & 1))
+  {
+    bits >>= 1;
+    ++bit;
+  }
+  return word * 64 + bit;
+}
+
+TileAdjacency::TileAdjacency() :
+  m_count(0),
+  m_words(0),
+  m_bits()
+{
+}
+
+void
+TileAdjacency::resize(size_t count)
+{
+  const size_t words = words_for(count);
+  const size_t kept = std::min(count, m_count);
+
+  for (auto& matrices : m_bits)
+  {
+    for (auto& bits : matrices)
+    {
+      std::vector<uint64_t> resized(count * words, 0);
+      for (size_t a = 0; a < kept; ++a)
+        std::copy_n(bits.begin() + a * m_words, std::min(words, m_words), resized.begin() + a * words);
+
+      // Clear columns of tiles that went away
+      if (count < m_count && count % 64 != 0)
+      {
+        const uint64_t mask = (uint64_t(1) << (count % 64)) - 1;
+        for (size_t a = 0; a < count; ++a)
+          resized[a * words + words - 1] &= mask;
+      }
+      bits = std::move(resized);
+    }
+  }
+
+  m_count = count;
+  m_words = words;
+}
+
+void
+TileAdjacency::erase(size_t index)
+{
+  if (index >= m_count)
+    return;
+
+  const size_t count = m_count - 1;
+  const size_t words = words_for(count);
+
+  for (auto& matrices : m_bits)
+  {
+    for (auto& bits : matrices)
+    {
+      std::vector<uint64_t> resized(count * words, 0);
+      size_t dst = 0;
+      for (size_t a = 0; a < m_count; ++a)
+      {
+        if (a == index)
+          continue;
+
+        uint64_t* src = bits.data() + a * m_words;
+        erase_bit(src, m_words, index);
+        std::copy_n(src, words, resized.begin() + dst * words);
+        ++dst;
+      }
+      bits = std::move(resized);
+    }
+  }
+
+  m_count = count;
+  m_words = words;
+}
+
+void
+TileAdjacency::clear()
+{
+  for (auto& matrices : m_bits)
+    for (auto& bits : matrices)
+      bits.clear();
+
+  m_count = 0;
+  m_words = 0;
+}
+
+void
+TileAdjacency::include(size_t a, Direction dir, size_t b)
+{
+  set(INCLUDED, a, dir, b);
+}
+
+void
+TileAdjacency::exclude(size_t a, Direction dir, size_t b)
+{
+  set(EXCLUDED, a, dir, b);
+}
+
+bool
+TileAdjacency::is_included(size_t a, Direction dir, size_t b) const
+{
+  return (row(INCLUDED, dir, a)[b / 64] >> (b % 64)) & 1;
+}
+
+bool
+TileAdjacency::is_excluded(size_t a, Direction dir, size_t b) const
+{
+  return (row(EXCLUDED, dir, a)[b / 64] >> (b % 64)) & 1;
+}
+
+bool
+TileAdjacency::is_decided(size_t a, Direction dir, size_t b) const
+{
+  return ((row(INCLUDED, dir, a)[b / 64] | row(EXCLUDED, dir, a)[b / 64]) >> (b % 64)) & 1;
+}
+
+TileAdjacency::Row
+TileAdjacency::get_included(size_t a, Direction dir) const
+{
+  return get_row(INCLUDED, a, dir);
+}
+
+TileAdjacency::Row
+TileAdjacency::get_excluded(size_t a, Direction dir) const
+{
+  return get_row(EXCLUDED, a, dir);
+}
+
+TileAdjacency::Row
+TileAdjacency::get_undecided(size_t a, Direction dir) const
+{
+  const uint64_t* included = row(INCLUDED, dir, a);
+  const uint64_t* excluded = row(EXCLUDED, dir, a);
+
+  Row result(m_words);
+  for (size_t i = 0; i < m_words; ++i)
+    result[i] = ~(included[i] | excluded[i]);
+
+  if (m_count % 64 != 0)
+    result.back() &= (uint64_t(1) << (m_count % 64)) - 1;
+  return result;
+}
+
+TileAdjacency::Row
+TileAdjacency::get_included_by_all(const std::vector<size_t>& tiles, Direction dir) const
+{
+  Row result(m_words, ~uint64_t(0));
+  if (m_count % 64 != 0)
+    result.back() = (uint64_t(1) << (m_count % 64)) - 1;
+
+  for (const auto a : tiles)
+  {
+    const uint64_t* included = row(INCLUDED, dir, a);
+    for (size_t i = 0; i < m_words; ++i)
+      result[i] &= included[i];
+  }
+  return result;
+}
+
+size_t
+TileAdjacency::get_bit_count(size_t count)
+{
+  return NUM_MATRICES * NUM_DIRECTIONS * count * words_for(count);
+}
+
+void
+TileAdjacency::save_bits(uint64_t* bits) const
+{
+  for (const auto& matrices : m_bits)
+  {
+    for (const auto& matrix : matrices)
+    {
+      std::copy(matrix.begin(), matrix.end(), bits);
+      bits += matrix.size();
+    }
+  }
+}
+
+void
+TileAdjacency::load_bits(size_t count, const uint64_t* bits)
+{
+  m_count = count;
+  m_words = words_for(count);
+
+  for (auto& matrices : m_bits)
+  {
+    for (auto& matrix : matrices)
+    {
+      matrix.assign(bits, bits + m_count * m_words);
+      bits += matrix.size();
+    }
+  }
+}
+
+uint64_t*
+TileAdjacency::row(Matrix matrix, Direction dir, size_t a)
+{
+  return m_bits[matrix][dir].data() + a * m_words;
+}
+
+const uint64_t*
+TileAdjacency::row(Matrix matrix, Direction dir, size_t a) const
+{
+  return m_bits[matrix][dir].data() + a * m_words;
+}
+
+void
+TileAdjacency::set(Matrix matrix, size_t a, Direction dir, size_t b)
+{
+  row(matrix, dir, a)[b / 64] |= uint64_t(1) << (b % 64);
+  row(matrix, opposite(dir), b)[a / 64] |= uint64_t(1) << (a % 64);
+}
+
+TileAdjacency::Row
+TileAdjacency::get_row(Matrix matrix, size_t a, Direction dir) const
+{
+  const uint64_t* bits = row(matrix, dir, a);
+  return Row(bits, bits + m_words);
+}
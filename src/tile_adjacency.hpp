@@ -0,0 +1,110 @@
+//  SuperTux Tile Manager - A utility for SuperTux to manage tiles
+//  Copyright (C) 2021 Semphris <semphris@protonmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _HEADER_STTILEMAN_TILE_ADJACENCY_HPP
+#define _HEADER_STTILEMAN_TILE_ADJACENCY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/** Pairing decisions between the selected tiles, indexed by their
+    position in g_selected_tiles. For every direction there is one bit
+    matrix of pairings that were accepted and one of those that were
+    rejected; row a holds the tiles that may (or may not) sit on that
+    side of tile a. */
+class TileAdjacency final
+{
+public:
+  enum Direction
+  {
+    UP,
+    LEFT,
+    DOWN,
+    RIGHT,
+    NUM_DIRECTIONS
+  };
+
+  static Direction opposite(Direction dir);
+
+  /** One bit per selected tile */
+  using Row = std::vector<uint64_t>;
+
+  static size_t count(const Row& row);
+  /** Returns the first set bit at or after index, or npos */
+  static size_t find_next(const Row& row, size_t index);
+  static const size_t npos = static_cast<size_t>(-1);
+
+public:
+  TileAdjacency();
+
+  /** Keeps the decisions of the tiles that remain */
+  void resize(size_t count);
+  /** Forgets a tile; the tiles after it move down one index. Does
+      nothing for tiles past size(). */
+  void erase(size_t index);
+  void clear();
+  size_t size() const { return m_count; }
+
+  /** Records whether b fits on the dir side of a, along with the
+      mirrored decision for a on the opposite side of b. */
+  void include(size_t a, Direction dir, size_t b);
+  void exclude(size_t a, Direction dir, size_t b);
+
+  bool is_included(size_t a, Direction dir, size_t b) const;
+  bool is_excluded(size_t a, Direction dir, size_t b) const;
+  bool is_decided(size_t a, Direction dir, size_t b) const;
+
+  Row get_included(size_t a, Direction dir) const;
+  Row get_excluded(size_t a, Direction dir) const;
+  Row get_undecided(size_t a, Direction dir) const;
+
+  /** Tiles that were accepted on the dir side of every one of tiles */
+  Row get_included_by_all(const std::vector<size_t>& tiles, Direction dir) const;
+
+  /** Number of words held for count tiles, across all matrices */
+  static size_t get_bit_count(size_t count);
+  size_t get_bit_count() const { return get_bit_count(m_count); }
+  /** Copies every matrix into, or out of, get_bit_count() words */
+  void save_bits(uint64_t* bits) const;
+  void load_bits(size_t count, const uint64_t* bits);
+
+private:
+  enum Matrix
+  {
+    INCLUDED,
+    EXCLUDED,
+    NUM_MATRICES
+  };
+
+  uint64_t* row(Matrix matrix, Direction dir, size_t a);
+  const uint64_t* row(Matrix matrix, Direction dir, size_t a) const;
+  void set(Matrix matrix, size_t a, Direction dir, size_t b);
+  Row get_row(Matrix matrix, size_t a, Direction dir) const;
+
+private:
+  size_t m_count;
+  size_t m_words;
+  std::vector<uint64_t> m_bits[NUM_MATRICES][NUM_DIRECTIONS];
+
+private:
+  TileAdjacency(const TileAdjacency&) = delete;
+  TileAdjacency& operator=(const TileAdjacency&) = delete;
+};
+
+extern TileAdjacency g_tile_adjacency;
+
+#endif
@@ -0,0 +1,203 @@
+//  SuperTux Tile Manager - A utility for SuperTux to manage tiles
+//  Copyright (C) 2021 Semphris <semphris@protonmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "tile_atlas.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "video/texture.hpp"
+#include "video/window.hpp"
+
+#include "image.hpp"
+#include "image_cache.hpp"
+#include "tile.hpp"
+
+TileAtlas g_tile_atlas;
+
+namespace {
+
+void clear_tile(Image& dst, int dst_x, int dst_y)
+{
+  for (int y = 0; y < TileAtlas::TILE_SIZE; ++y)
+    std::memset(dst.get_pixels() + (dst_y + y) * dst.get_pitch() + dst_x * 4, 0, TileAtlas::TILE_SIZE * 4);
+}
+
+/** Copies a tile from src into dst, leaving transparent whatever part
+    of it lies outside src */
+void copy_tile(const Image& src, const Rect& srcrect, Image& dst, int dst_x, int dst_y)
+{
+  const int size = TileAtlas::TILE_SIZE;
+  clear_tile(dst, dst_x, dst_y);
+
+  const int x1 = static_cast<int>(srcrect.x1);
+  const int y1 = static_cast<int>(srcrect.y1);
+  const int left = std::max(0, -x1);
+  const int top = std::max(0, -y1);
+  const int right = std::min(size, src.get_width() - x1);
+  const int bottom = std::min(size, src.get_height() - y1);
+  if (right <= left || bottom <= top)
+    return;
+
+  for (int y = top; y < bottom; ++y)
+    std::memcpy(dst.get_pixels() + (dst_y + y) * dst.get_pitch() + (dst_x + left) * 4,
+                src.get_pixels() + (y1 + y) * src.get_pitch() + (x1 + left) * 4,
+                (right - left) * 4);
+}
+
+} // namespace
+
+TileAtlas::TileAtlas() :
+  m_pages(),
+  m_slot_by_id(),
+  m_slots(),
+  m_free(),
+  m_next_slot(0),
+  m_selection_revision(0),
+  m_synced(false),
+  m_revision(0),
+  m_uploads(0)
+{
+}
+
+void
+TileAtlas::update()
+{
+  if (m_synced && m_selection_revision == g_selected_tiles.get_revision())
+    return;
+
+  m_synced = true;
+  m_selection_revision = g_selected_tiles.get_revision();
+  m_revision++;
+
+  if (g_selected_tiles.empty())
+  {
+    m_pages.clear();
+    m_slot_by_id.clear();
+    m_slots.clear();
+    m_free.clear();
+    m_next_slot = 0;
+    return;
+  }
+
+  // Free the slots of tiles that were unselected
+  for (auto it = m_slot_by_id.begin(); it != m_slot_by_id.end();)
+  {
+    if (g_selected_tiles.contains(it->first))
+    {
+      ++it;
+    }
+    else
+    {
+      m_free.push_back(it->second);
+      it = m_slot_by_id.erase(it);
+    }
+  }
+
+  // Lowest slots first, so that tiles gather on the first pages
+  std::sort(m_free.begin(), m_free.end(), std::greater<uint32_t>());
+
+  std::vector<size_t> added;
+  m_slots.resize(g_selected_tiles.size());
+  for (size_t i = 0; i < g_selected_tiles.size(); ++i)
+  {
+    const SelectedTile& tile = g_selected_tiles[i];
+    const auto it = m_slot_by_id.find(tile.id);
+    if (it != m_slot_by_id.end())
+    {
+      m_slots[i] = it->second;
+      continue;
+    }
+
+    const uint32_t slot = allocate();
+    m_slot_by_id[tile.id] = slot;
+    m_slots[i] = slot;
+    added.push_back(i);
+  }
+
+  // Images are only acquired for groups that have new tiles
+  const auto images = acquire_group_images(g_selected_tiles, "copy tiles from", &added);
+
+  for (const size_t i : added)
+  {
+    const uint32_t slot = m_slots[i];
+    Page& page = m_pages[slot / SLOTS_PER_PAGE];
+    page.dirty = true;
+
+    const Rect slot_rect = get_slot_rect(slot);
+    const int x = static_cast<int>(slot_rect.x1);
+    const int y = static_cast<int>(slot_rect.y1);
+
+    const ImageHandle& image = images.at(g_selected_tiles[i].handle.group);
+    if (image)
+      copy_tile(image->get_image(), g_selected_tiles.get_srcrect(i), *page.image, x, y);
+    else
+      clear_tile(*page.image, x, y);
+  }
+}
+
+TileAtlas::Entry
+TileAtlas::get(Window& window, size_t index)
+{
+  const uint32_t slot = m_slots.at(index);
+  Page& page = m_pages[slot / SLOTS_PER_PAGE];
+  if (page.dirty || !page.texture)
+  {
+    page.texture = page.image->upload(window);
+    page.dirty = false;
+    m_uploads++;
+  }
+
+  return { page.texture.get(), get_slot_rect(slot) };
+}
+
+void
+TileAtlas::clear()
+{
+  m_pages.clear();
+  m_slot_by_id.clear();
+  m_slots.clear();
+  m_free.clear();
+  m_next_slot = 0;
+  m_synced = false;
+  m_revision++;
+}
+
+uint32_t
+TileAtlas::allocate()
+{
+  if (!m_free.empty())
+  {
+    const uint32_t slot = m_free.back();
+    m_free.pop_back();
+    return slot;
+  }
+
+  const uint32_t slot = m_next_slot++;
+  if (slot / SLOTS_PER_PAGE >= m_pages.size())
+    m_pages.push_back({ Image::create(PAGE_SIZE, PAGE_SIZE), nullptr, true });
+  return slot;
+}
+
+Rect
+TileAtlas::get_slot_rect(uint32_t slot) const
+{
+  const uint32_t cell = slot % SLOTS_PER_PAGE;
+  const Vector pos(static_cast<float>(cell % SLOTS_PER_ROW * TILE_SIZE),
+                   static_cast<float>(cell / SLOTS_PER_ROW * TILE_SIZE));
+  return Rect(pos, Size(TILE_SIZE, TILE_SIZE));
+}
@@ -0,0 +1,104 @@
+//  SuperTux Tile Manager - A utility for SuperTux to manage tiles
+//  Copyright (C) 2021 Semphris <semphris@protonmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef _HEADER_STTILEMAN_TILE_ATLAS_HPP
+#define _HEADER_STTILEMAN_TILE_ATLAS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "util/rect.hpp"
+
+class Image;
+class Texture;
+class Window;
+
+/** The selected tiles, copied side by side into a few textures so that
+    tiles from any group are drawn from the same place. Tiles are all
+    32x32, so each page is a grid of slots. A tile keeps its slot until
+    it is unselected and new tiles take freed slots first; only the
+    pages that received tiles are uploaded again. Main thread only. */
+class TileAtlas final
+{
+public:
+  static const int PAGE_SIZE = 1024;
+  static const int TILE_SIZE = 32;
+  static const int SLOTS_PER_ROW = PAGE_SIZE / TILE_SIZE;
+  static const int SLOTS_PER_PAGE = SLOTS_PER_ROW * SLOTS_PER_ROW;
+
+  struct Entry
+  {
+    const Texture* texture;
+    Rect srcrect;
+  };
+
+public:
+  TileAtlas();
+
+  /** Copies newly selected tiles in and frees the slots of unselected
+      ones. Does nothing if g_selected_tiles didn't change since. */
+  void update();
+
+  /** Where to draw the selected tile at index from. Uploads its page if
+      it changed; the texture stays valid until the next update(). */
+  Entry get(Window& window, size_t index);
+
+  /** Changes whenever what get() returns may have changed */
+  uint64_t get_revision() const { return m_revision; }
+
+  size_t get_page_count() const { return m_pages.size(); }
+  size_t get_uploads() const { return m_uploads; }
+
+  /** Forgets every tile, so that they are copied again from the current
+      images. Must also be called before the window goes away. */
+  void clear();
+
+private:
+  struct Page
+  {
+    std::unique_ptr<Image> image;
+    std::shared_ptr<Texture> texture;
+    bool dirty;
+  };
+
+private:
+  uint32_t allocate();
+  Rect get_slot_rect(uint32_t slot) const;
+
+private:
+  std::vector<Page> m_pages;
+  std::unordered_map<uint32_t, uint32_t> m_slot_by_id;
+  /** The slot of each selected tile, indexed like g_selected_tiles */
+  std::vector<uint32_t> m_slots;
+  std::vector<uint32_t> m_free;
+  uint32_t m_next_slot;
+  uint64_t m_selection_revision;
+  bool m_synced;
+  uint64_t m_revision;
+  size_t m_uploads;
+
+private:
+  TileAtlas(const TileAtlas&) = delete;
+  TileAtlas& operator=(const TileAtlas&) = delete;
+};
+
+extern TileAtlas g_tile_atlas;
+
+#endif
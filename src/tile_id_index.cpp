@@ -0,0 +1,175 @@
+//  SuperTux Tile Manager - A utility for SuperTux to manage tiles
+//  Copyright (C) 2021 Semphris <semphris@protonmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "tile_id_index.hpp"
+
+#include <algorithm>
+
+TileIdIndex g_tile_index;
+
+namespace {
+
+/** Fibonacci hashing: the slot comes from the high bits of the
+    product, which depend on every bit of the id. The low bits only
+    depend on the low bits of the id, so ids with a power of two stride
+    would all land in the same few slots. */
+size_t hash_id(uint32_t id, unsigned int shift)
+{
+  return (id * 0x9e3779b1u) >> shift;
+}
+
+} // namespace
+
+TileIdIndex::TileIdIndex() :
+  m_dense(true),
+  m_size(0),
+  m_min_id(0),
+  m_max_id(0),
+  m_handles(),
+  m_keys(),
+  m_mask(0),
+  m_shift(32)
+{
+}
+
+void
+TileIdIndex::build(const std::vector<TileGroup>& groups, std::vector<Duplicate>* duplicates)
+{
+  clear();
+
+  size_t count = 0;
+  uint32_t min_id = UINT32_MAX;
+  uint32_t max_id = 0;
+  for (const auto& group : groups)
+  {
+    for (const auto id : group.tiles.get_ids())
+    {
+      if (id == 0)
+        continue;
+      ++count;
+      min_id = std::min(min_id, id);
+      max_id = std::max(max_id, id);
+    }
+  }
+  if (count == 0)
+    return;
+
+  m_min_id = min_id;
+  m_max_id = max_id;
+
+  // A flat array costs 8 bytes per possible id, the table about 24 per
+  // tile at the load factor used below.
+  const size_t range = static_cast<size_t>(max_id - min_id) + 1;
+  m_dense = range <= count * 3 + 1024;
+  if (m_dense)
+  {
+    m_handles.assign(range, TileHandle{ NO_GROUP, 0, 0 });
+  }
+  else
+  {
+    size_t capacity = 16;
+    m_shift = 28;
+    while (capacity < count * 2)
+    {
+      capacity *= 2;
+      m_shift--;
+    }
+
+    m_keys.assign(capacity, 0);
+    m_handles.resize(capacity);
+    m_mask = capacity - 1;
+  }
+
+  for (size_t g = 0; g < groups.size(); ++g)
+  {
+    const auto& ids = groups[g].tiles.get_ids();
+    for (size_t i = 0; i < ids.size(); ++i)
+    {
+      if (ids[i] == 0)
+        continue;
+
+      const TileHandle handle = { static_cast<uint16_t>(g), 0, static_cast<uint32_t>(i) };
+      const TileHandle* existing = insert(ids[i], handle);
+      if (existing && duplicates)
+        duplicates->push_back({ ids[i], *existing, handle });
+    }
+  }
+}
+
+void
+TileIdIndex::clear()
+{
+  m_dense = true;
+  m_size = 0;
+  m_min_id = 0;
+  m_max_id = 0;
+  m_handles.clear();
+  m_keys.clear();
+  m_mask = 0;
+  m_shift = 32;
+}
+
+const TileHandle*
+TileIdIndex::find(uint32_t id) const
+{
+  if (id == 0)
+    return nullptr;
+
+  if (m_dense)
+  {
+    if (id < m_min_id || id - m_min_id >= m_handles.size() ||
+        m_handles[id - m_min_id].group == NO_GROUP)
+      return nullptr;
+    return &m_handles[id - m_min_id];
+  }
+
+  if (m_keys.empty())
+    return nullptr;
+
+  for (size_t slot = hash_id(id, m_shift); m_keys[slot] != 0; slot = (slot + 1) & m_mask)
+  {
+    if (m_keys[slot] == id)
+      return &m_handles[slot];
+  }
+  return nullptr;
+}
+
+const TileHandle*
+TileIdIndex::insert(uint32_t id, const TileHandle& handle)
+{
+  if (m_dense)
+  {
+    TileHandle& slot = m_handles[id - m_min_id];
+    if (slot.group != NO_GROUP)
+      return &slot;
+
+    slot = handle;
+    ++m_size;
+    return nullptr;
+  }
+
+  size_t slot = hash_id(id, m_shift);
+  for (; m_keys[slot] != 0; slot = (slot + 1) & m_mask)
+  {
+    if (m_keys[slot] == id)
+      return &m_handles[slot];
+  }
+
+  m_keys[slot] = id;
+  m_handles[slot] = handle;
+  ++m_size;
+  return nullptr;
+}
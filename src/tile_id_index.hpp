@@ -0,0 +1,83 @@
+//  SuperTux Tile Manager - A utility for SuperTux to manage tiles
+//  Copyright (C) 2021 Semphris <semphris@protonmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _HEADER_STTILEMAN_TILE_ID_INDEX_HPP
+#define _HEADER_STTILEMAN_TILE_ID_INDEX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "tile.hpp"
+
+/** Finds a tile by id across every group. Ids that are close together
+    go into a flat array indexed by id minus the smallest id; scattered
+    ids go into an open addressing hash table. Id 0 (no tile) is never
+    indexed. */
+class TileIdIndex final
+{
+public:
+  /** An id that appears more than once; the first one is the one indexed */
+  struct Duplicate
+  {
+    uint32_t id;
+    TileHandle first;
+    TileHandle second;
+  };
+
+public:
+  TileIdIndex();
+
+  void build(const std::vector<TileGroup>& groups, std::vector<Duplicate>* duplicates = nullptr);
+  void clear();
+
+  /** Returns nullptr if no group has the id */
+  const TileHandle* find(uint32_t id) const;
+
+  size_t size() const { return m_size; }
+  bool is_dense() const { return m_dense; }
+
+  /** The range of indexed ids; both are 0 while the index is empty */
+  uint32_t get_min_id() const { return m_min_id; }
+  uint32_t get_max_id() const { return m_max_id; }
+
+private:
+  /** Marks free slots of the flat array */
+  static const uint16_t NO_GROUP = 0xffff;
+
+  const TileHandle* insert(uint32_t id, const TileHandle& handle);
+
+private:
+  bool m_dense;
+  size_t m_size;
+  uint32_t m_min_id;
+  uint32_t m_max_id;
+  /** Dense: indexed by id - m_min_id. Sparse: parallel to m_keys. */
+  std::vector<TileHandle> m_handles;
+  /** Sparse only; 0 marks a free slot */
+  std::vector<uint32_t> m_keys;
+  size_t m_mask;
+  /** 32 - log2 of the table size */
+  unsigned int m_shift;
+
+private:
+  TileIdIndex(const TileIdIndex&) = delete;
+  TileIdIndex& operator=(const TileIdIndex&) = delete;
+};
+
+extern TileIdIndex g_tile_index;
+
+#endif
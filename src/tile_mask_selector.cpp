@@ -16,13 +16,18 @@
 
 #include "tile_mask_selector.hpp"
 
+#include <algorithm>
+
 #include "SDL.h"
 
+#include "util/log.hpp"
 #include "video/drawing_context.hpp"
 #include "video/renderer.hpp"
 #include "video/window.hpp"
 
 #include "main.hpp"
+#include "session.hpp"
+#include "tile_atlas.hpp"
 #include "tile_pairings.hpp"
 #include "tile_selector.hpp"
 
@@ -54,6 +59,8 @@ TileMaskSelector::get_col(short mask)
 TileMaskSelector::TileMaskSelector(Window& window) :
   Scene(window),
   m_current_tile(0),
+  m_guesses(),
+  m_uncertain_edges(0),
   m_btn_prev_tile("Prev. tile", [this](int){ prev_tile(); }, 0xff, true, 100, Rect(), theme_set, nullptr),
   m_btn_next_tile("Next tile", [this](int){ next_tile(); }, 0xff, true, 100, Rect(), theme_set, nullptr),
   m_btn_go_back("Go back", [this](int){ change_scene(std::make_unique<TileSelector>(m_window)); }, 0xff, true, 100, Rect(), theme_set, nullptr),
@@ -61,11 +68,16 @@ TileMaskSelector::TileMaskSelector(Window& window) :
 {
   m_btn_prev_tile.set_disabled(true);
   resize_elements();
+  guess_masks();
+  g_session.save("masks");
 }
 
 void
 TileMaskSelector::event(const SDL_Event& event)
 {
+  // Any input may change what is hovered or pressed
+  invalidate();
+
   if (m_btn_prev_tile.event(event) || m_btn_next_tile.event(event) || m_btn_go_back.event(event) || m_btn_next_step.event(event))
     return;
 
@@ -102,6 +114,12 @@ TileMaskSelector::event(const SDL_Event& event)
       {
         g_selected_tiles[m_current_tile].non_solid = !g_selected_tiles[m_current_tile].non_solid;
       }
+      else
+      {
+        break;
+      }
+
+      g_session.record_masks(m_current_tile);
     }
       break;
 
@@ -125,17 +143,50 @@ TileMaskSelector::draw() const
 
   Vector mid = m_window.get_size() / 2.f;
   Rect tile_rect = Rect(mid - Vector(16.f, 16.f), Size(32.f, 32.f));
-  const auto& t = *g_tilegroup->texture;
-  const auto& src = g_selected_tiles[m_current_tile].srcrect;
-  dc.draw_texture(t, src, tile_rect, 0.f, g_selected_tiles[m_current_tile].non_solid ? Color(1.f, .5f, .5f) : Color(1.f, 1.f, 1.f), Renderer::Blend::BLEND, 1);
+  g_tile_atlas.update();
+  const auto tile = g_tile_atlas.get(m_window, m_current_tile);
+  dc.draw_texture(*tile.texture, tile.srcrect, tile_rect, 0.f, g_selected_tiles[m_current_tile].non_solid ? Color(1.f, .5f, .5f) : Color(1.f, 1.f, 1.f), Renderer::Blend::BLEND, 1);
   dc.draw_filled_rect(tile_rect.moved(Vector(32.f, 0.f)), get_col(g_selected_tiles[m_current_tile].mask_right), Renderer::Blend::BLEND, 1);
   dc.draw_filled_rect(tile_rect.moved(Vector(0, -32.f)), get_col(g_selected_tiles[m_current_tile].mask_up), Renderer::Blend::BLEND, 1);
   dc.draw_filled_rect(tile_rect.moved(Vector(-32.f, 0.f)), get_col(g_selected_tiles[m_current_tile].mask_left), Renderer::Blend::BLEND, 1);
   dc.draw_filled_rect(tile_rect.moved(Vector(0, 32.f)), get_col(g_selected_tiles[m_current_tile].mask_down), Renderer::Blend::BLEND, 1);
 
+  // How sure the guess for each edge was, in the order of TileAdjacency::Direction
+  if (m_current_tile < static_cast<int>(m_guesses.size()))
+  {
+    const Vector offsets[] = { Vector(0.f, -32.f), Vector(-32.f, 0.f), Vector(0.f, 32.f), Vector(32.f, 0.f) };
+    for (int i = 0; i < 4; ++i)
+    {
+      const EdgeGuess& edge = m_guesses[m_current_tile].edges[i];
+      const Color color = edge.confidence < .5f ? Color(1.f, 1.f, 0.f) : Color(1.f, 1.f, 1.f);
+      dc.draw_text(std::to_string(static_cast<int>(edge.confidence * 100.f + .5f)) + "%",
+                   mid + offsets[i] - Vector(0.f, 6.f), Renderer::TextAlign::TOP_MID,
+                   "../data/fonts/SuperTux-Medium.ttf", 10, color, Renderer::Blend::BLEND, 2);
+    }
+  }
+
+  dc.draw_text("Guessed from the pixels; " + std::to_string(m_uncertain_edges) + " uncertain edge(s) in yellow",
+               Vector(r.get_window().get_size().w / 2.f, 28.f), Renderer::TextAlign::TOP_MID,
+               "../data/fonts/SuperTux-Medium.ttf", 14, Color(1.f, 1.f, 1.f), Renderer::Blend::BLEND, 10);
+
   dc.render();
 }
 
+void
+TileMaskSelector::tileset_reloaded()
+{
+  if (g_selected_tiles.empty())
+  {
+    change_scene(std::make_unique<TileSelector>(m_window));
+    return;
+  }
+
+  m_current_tile = std::min(m_current_tile, static_cast<int>(g_selected_tiles.size()) - 1);
+  guess_masks();
+  m_btn_prev_tile.set_disabled(m_current_tile <= 0);
+  m_btn_next_tile.set_disabled(m_current_tile >= static_cast<int>(g_selected_tiles.size()) - 1);
+}
+
 void
 TileMaskSelector::next_tile()
 {
@@ -166,3 +217,33 @@ TileMaskSelector::resize_elements()
   m_btn_go_back.get_rect() = Rect(m_window.get_size().w / 2.f, m_window.get_size().h - 32.f, m_window.get_size().w * 3.f / 4.f, m_window.get_size().h);
   m_btn_next_step.get_rect() = Rect(m_window.get_size().w * 3.f / 4.f, m_window.get_size().h - 32.f, m_window.get_size().w, m_window.get_size().h);
 }
+
+void
+TileMaskSelector::guess_masks()
+{
+  m_guesses = MaskInference::infer_all(g_selected_tiles);
+  m_uncertain_edges = 0;
+
+  size_t guessed = 0;
+  for (size_t i = 0; i < m_guesses.size(); ++i)
+  {
+    const MaskGuess& guess = m_guesses[i];
+    for (const auto& edge : guess.edges)
+      if (edge.confidence < .5f)
+        m_uncertain_edges++;
+
+    SelectedTile& tile = g_selected_tiles[i];
+    if (tile.flags & SelectedTile::MASKS_GUESSED)
+      continue;
+
+    tile.mask_up = guess.edges[0].mask;
+    tile.mask_left = guess.edges[1].mask;
+    tile.mask_down = guess.edges[2].mask;
+    tile.mask_right = guess.edges[3].mask;
+    tile.flags |= SelectedTile::MASKS_GUESSED;
+    guessed++;
+  }
+
+  log_info << "Guessed the masks of " << guessed << " tile(s); " << m_uncertain_edges << " of "
+           << m_guesses.size() * 4 << " edges are uncertain" << std::endl;
+}
@@ -26,6 +26,7 @@
 #include "util/color.hpp"
 #include "util/rect.hpp"
 
+#include "mask_inference.hpp"
 #include "tile.hpp"
 
 class TileMaskSelector :
@@ -42,6 +43,7 @@ public:
   virtual void event(const SDL_Event& event) override;
   virtual void update(float dt_sec) override {}
   virtual void draw() const override;
+  virtual void tileset_reloaded() override;
 
   void next_tile();
   void prev_tile();
@@ -49,8 +51,14 @@ public:
 private:
   void resize_elements();
 
+  /** Fills in the masks of tiles that weren't guessed yet, and keeps the
+      guesses of every tile to show how sure each edge is */
+  void guess_masks();
+
 private:
   int m_current_tile;
+  std::vector<MaskGuess> m_guesses;
+  size_t m_uncertain_edges;
   ButtonLabel m_btn_prev_tile;
   ButtonLabel m_btn_next_tile;
   ButtonLabel m_btn_go_back;
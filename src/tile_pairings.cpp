@@ -26,7 +26,14 @@
 #include "video/window.hpp"
 
 #include "main.hpp"
+#include "parallel.hpp"
+#include "session.hpp"
+#include "tile_atlas.hpp"
 #include "tile_mask_selector.hpp"
+#include "tile_selector.hpp"
+
+// Space between the pairs of the batch grid
+static const float BATCH_PADDING = 8.f;
 
 static const Control::ThemeSet theme_set = ([]{
   Control::Theme t;
@@ -49,21 +56,34 @@ static const Control::ThemeSet theme_set = ([]{
 
 TilePairings::TilePairings(Window& window) :
   Scene(window),
-  m_current_tile(0),
-  m_current_match(0),
-  m_match_direction(0),
+  m_queue(),
+  m_seams(),
+  m_auto_included(0),
+  m_auto_excluded(0),
+  m_propagated(0),
+  m_batch_mode(false),
+  m_batch(),
+  m_batch_fits(),
+  m_batch_columns(1),
+  m_batch_layer(),
   m_btn_yes("Yes", [this](int){ yes(); }, 0xff, true, 100, Rect(), theme_set, nullptr),
   m_btn_no("No", [this](int){ no(); }, 0xff, true, 100, Rect(), theme_set, nullptr),
   m_btn_prev("Go back", [this](int){ change_scene(std::make_unique<TileMaskSelector>(m_window)); }, 0xff, true, 100, Rect(), theme_set, nullptr),
-  m_btn_next("Next step", [this](int){}, 0xff, true, 100, Rect(), theme_set, nullptr)
+  m_btn_next("Next step", [this](int){}, 0xff, true, 100, Rect(), theme_set, nullptr),
+  m_btn_batch("Batch mode", [this](int){ toggle_batch(); }, 0xff, true, 100, Rect(), theme_set, nullptr)
 {
   resize_elements();
+  rebuild_queue();
 }
 
 void
 TilePairings::event(const SDL_Event& event)
 {
-  if (m_btn_yes.event(event) || m_btn_no.event(event) || m_btn_prev.event(event) || m_btn_next.event(event))
+  // Any input may change what is hovered or pressed
+  invalidate();
+
+  if (m_btn_yes.event(event) || m_btn_no.event(event) || m_btn_prev.event(event) || m_btn_next.event(event) ||
+      m_btn_batch.event(event))
     return;
 
   switch (event.type)
@@ -72,6 +92,31 @@ TilePairings::event(const SDL_Event& event)
       change_scene(nullptr);
       break;
 
+    case SDL_WINDOWEVENT:
+      if (event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED)
+      {
+        resize_elements();
+        if (m_batch_mode)
+          refresh_batch();
+      }
+      break;
+
+    case SDL_MOUSEBUTTONUP:
+      if (m_batch_mode && event.button.button == SDL_BUTTON_LEFT)
+      {
+        const Vector pos(static_cast<float>(event.button.x), static_cast<float>(event.button.y));
+        for (size_t i = 0; i < m_batch.size(); ++i)
+        {
+          if (get_cell_rect(i).contains(pos))
+          {
+            m_batch_fits[i] = !m_batch_fits[i];
+            m_batch_layer.invalidate();
+            break;
+          }
+        }
+      }
+      break;
+
     default:
       break;
   }
@@ -86,198 +131,347 @@ void
 TilePairings::draw() const
 {
   auto& r = m_window.get_renderer();
+  const Size ws = m_window.get_size();
+
+  // The grid goes into a layer of its own first, as that renders on its own
+  const Texture* batch = nullptr;
+  if (m_batch_mode && !m_batch.empty())
+  {
+    g_tile_atlas.update();
+    batch = &m_batch_layer.get(m_window, [this](DrawingContext& layer) {
+      const Vector offset = get_offset(m_batch.front().dir);
+      for (size_t i = 0; i < m_batch.size(); ++i)
+      {
+        const Rect cell = get_cell_rect(i);
+        const Vector mid = cell.top_lft() + cell.size().vector() / 2.f;
+        const Rect tile_rect = Rect(mid - Vector(16.f, 16.f), Size(32.f, 32.f));
+
+        layer.draw_filled_rect(Rect(cell.x1 - 3.f, cell.y1 - 3.f, cell.x2 + 3.f, cell.y2 + 3.f),
+                               m_batch_fits[i] ? Color(.2f, .7f, .2f) : Color(.35f, .1f, .1f),
+                               Renderer::Blend::NONE, 1);
+
+        const auto tile = g_tile_atlas.get(m_window, m_batch[i].tile);
+        layer.draw_texture(*tile.texture, tile.srcrect, tile_rect.moved(-offset), 0.f, Color(1.f, 1.f, 1.f), Renderer::Blend::BLEND, 2);
+        const auto match = g_tile_atlas.get(m_window, m_batch[i].match);
+        layer.draw_texture(*match.texture, match.srcrect, tile_rect.moved(offset), 0.f, Color(1.f, 1.f, 1.f), Renderer::Blend::BLEND, 2);
+      }
+    });
+  }
+
   DrawingContext dc(r);
 
   m_btn_yes.draw(dc);
   m_btn_no.draw(dc);
   m_btn_prev.draw(dc);
   m_btn_next.draw(dc);
+  m_btn_batch.draw(dc);
 
-  dc.draw_text("Does this pairing tile properly?", Vector(r.get_window().get_size().w / 2.f, 8.f), Renderer::TextAlign::TOP_MID, "../data/fonts/SuperTux-Medium.ttf", 16, Color(1.f, 1.f, 1.f), Renderer::Blend::BLEND, 10);
+  dc.draw_text(m_batch_mode ? "Click the pairings that tile properly; Yes commits the page, No rejects all of it"
+                            : "Does this pairing tile properly?", Vector(r.get_window().get_size().w / 2.f, 8.f), Renderer::TextAlign::TOP_MID, "../data/fonts/SuperTux-Medium.ttf", 16, Color(1.f, 1.f, 1.f), Renderer::Blend::BLEND, 10);
 
   Vector mid = m_window.get_size() / 2.f;
   Rect tile_rect = Rect(mid - Vector(16.f, 16.f), Size(32.f, 32.f));
 
-  Vector delta;
-  switch(m_match_direction)
+  const std::string progress = std::to_string(m_queue.get_remaining()) + " of " +
+                               std::to_string(m_queue.get_total()) + " questions left, " +
+                               std::to_string(m_auto_included + m_auto_excluded) + " answered from the pixels";
+  dc.draw_text(progress, Vector(r.get_window().get_size().w / 2.f, 28.f), Renderer::TextAlign::TOP_MID, "../data/fonts/SuperTux-Medium.ttf", 14, Color(1.f, 1.f, 1.f), Renderer::Blend::BLEND, 10);
+
+  const std::string classes = std::to_string(m_seams.get_class_count()) + " edge classes, " +
+                              std::to_string(m_seams.get_shared_edges()) + " shared edges, largest class " +
+                              std::to_string(m_seams.get_largest_class()) + ", " +
+                              std::to_string(m_propagated) + " answered through identical edges";
+  dc.draw_text(classes, Vector(r.get_window().get_size().w / 2.f, 46.f), Renderer::TextAlign::TOP_MID, "../data/fonts/SuperTux-Medium.ttf", 14, Color(.8f, .8f, .8f), Renderer::Blend::BLEND, 10);
+
+  if (m_queue.empty())
   {
-    case 0:
-      delta = Vector(0.f, 16.f);
-      break;
+    dc.render();
+    return;
+  }
 
-    case 1:
-      delta = Vector(0.f, -16.f);
-      break;
+  if (batch)
+  {
+    dc.draw_texture(*batch, Rect(ws), Rect(ws), 0.f, Color(1.f, 1.f, 1.f), Renderer::Blend::BLEND, 1);
+    dc.render();
+    return;
+  }
 
-    case 2:
-      delta = Vector(16.f, 0.f);
-      break;
+  const auto candidate = m_queue.front();
+  const Vector delta = get_offset(candidate.dir);
 
-    case 3:
-      delta = Vector(-16.f, 0.f);
-      break;
+  g_tile_atlas.update();
 
-    default:
-      break;
+  {
+    const auto tile = g_tile_atlas.get(m_window, candidate.tile);
+    dc.draw_texture(*tile.texture, tile.srcrect, tile_rect.moved(-delta), 0.f, Color(1.f, 1.f, 1.f), Renderer::Blend::BLEND, 1);
   }
 
   {
-    const auto& src = g_selected_tiles[m_current_tile].srcrect;
-    dc.draw_texture(*g_tilegroup->texture, src, tile_rect.moved(-delta), 0.f, Color(1.f, 1.f, 1.f), Renderer::Blend::BLEND, 1);
+    const auto tile = g_tile_atlas.get(m_window, candidate.match);
+    dc.draw_texture(*tile.texture, tile.srcrect, tile_rect.moved(delta), 0.f, Color(1.f, 1.f, 1.f), Renderer::Blend::BLEND, 1);
   }
 
+  dc.render();
+}
+
+void
+TilePairings::tileset_reloaded()
+{
+  if (g_selected_tiles.empty())
   {
-    const auto& src = g_selected_tiles[m_current_match].srcrect;
-    dc.draw_texture(*g_tilegroup->texture, src, tile_rect.moved(delta), 0.f, Color(1.f, 1.f, 1.f), Renderer::Blend::BLEND, 1);
+    change_scene(std::make_unique<TileSelector>(m_window));
+    return;
   }
 
-  dc.render();
+  // Indices may have moved; the decisions themselves were kept
+  rebuild_queue();
 }
 
 void
 TilePairings::yes()
 {
-  switch (m_match_direction)
-  {
-    case 0:
-      g_selected_tiles[m_current_tile].in_down.push_back(&g_selected_tiles[m_current_match]);
-      g_selected_tiles[m_current_match].in_up.push_back(&g_selected_tiles[m_current_tile]);
-      break;
+  if (m_batch_mode)
+    commit_batch(false);
+  else
+    answer(true);
+}
 
-    case 1:
-      g_selected_tiles[m_current_tile].in_up.push_back(&g_selected_tiles[m_current_match]);
-      g_selected_tiles[m_current_match].in_down.push_back(&g_selected_tiles[m_current_tile]);
-      break;
+void
+TilePairings::no()
+{
+  if (m_batch_mode)
+    commit_batch(true);
+  else
+    answer(false);
+}
 
-    case 2:
-      g_selected_tiles[m_current_tile].in_right.push_back(&g_selected_tiles[m_current_match]);
-      g_selected_tiles[m_current_match].in_left.push_back(&g_selected_tiles[m_current_tile]);
-      break;
+void
+TilePairings::toggle_batch()
+{
+  m_batch_mode = !m_batch_mode;
+  next_question();
+}
 
-    case 3:
-      g_selected_tiles[m_current_tile].in_left.push_back(&g_selected_tiles[m_current_match]);
-      g_selected_tiles[m_current_match].in_right.push_back(&g_selected_tiles[m_current_tile]);
-      break;
+Vector
+TilePairings::get_offset(TileAdjacency::Direction dir)
+{
+  switch (dir)
+  {
+    case TileAdjacency::DOWN:
+      return Vector(0.f, 16.f);
+    case TileAdjacency::UP:
+      return Vector(0.f, -16.f);
+    case TileAdjacency::RIGHT:
+      return Vector(16.f, 0.f);
+    case TileAdjacency::LEFT:
+      return Vector(-16.f, 0.f);
+    default:
+      return Vector();
   }
-
-  next();
 }
 
 void
-TilePairings::no()
+TilePairings::rebuild_queue()
 {
-  switch (m_match_direction)
-  {
-    case 0:
-      g_selected_tiles[m_current_tile].ex_down.push_back(&g_selected_tiles[m_current_match]);
-      g_selected_tiles[m_current_match].ex_up.push_back(&g_selected_tiles[m_current_tile]);
-      break;
+  g_tile_adjacency.resize(g_selected_tiles.size());
+  m_queue.build();
+  answer_obvious();
+  log_info << m_queue.get_remaining() << " pairing(s) to ask about; " << m_seams.get_class_count()
+           << " edge classes, " << m_seams.get_shared_edges() << " edges shared" << std::endl;
+  m_propagated = 0;
 
-    case 1:
-      g_selected_tiles[m_current_tile].ex_up.push_back(&g_selected_tiles[m_current_match]);
-      g_selected_tiles[m_current_match].ex_down.push_back(&g_selected_tiles[m_current_tile]);
-      break;
+  next_question();
 
-    case 2:
-      g_selected_tiles[m_current_tile].ex_right.push_back(&g_selected_tiles[m_current_match]);
-      g_selected_tiles[m_current_match].ex_left.push_back(&g_selected_tiles[m_current_tile]);
-      break;
+  // The answers from the pixels go into the snapshot; later ones are journaled
+  g_session.save("pairings");
+}
 
-    case 3:
-      g_selected_tiles[m_current_tile].ex_left.push_back(&g_selected_tiles[m_current_match]);
-      g_selected_tiles[m_current_match].ex_right.push_back(&g_selected_tiles[m_current_tile]);
-      break;
+void
+TilePairings::answer_obvious()
+{
+  m_seams.load(g_selected_tiles);
+
+  const auto candidates = m_queue.get_candidates();
+  std::vector<SeamScorer::Verdict> verdicts(candidates.size());
+  parallel_for(candidates.size(), [&](size_t i) {
+    verdicts[i] = m_seams.judge(candidates[i].tile, candidates[i].dir, candidates[i].match);
+  });
+
+  m_auto_included = 0;
+  m_auto_excluded = 0;
+  for (size_t i = 0; i < candidates.size(); ++i)
+  {
+    if (verdicts[i] == SeamScorer::UNSURE)
+      continue;
+
+    const bool fits = verdicts[i] == SeamScorer::FITS;
+    m_queue.decide(candidates[i], fits);
+    if (fits)
+      m_auto_included++;
+    else
+      m_auto_excluded++;
   }
 
-  next();
+  log_info << "Answered " << m_auto_included + m_auto_excluded << " of " << candidates.size()
+           << " pairing(s) from the pixels (" << m_auto_included << " yes, "
+           << m_auto_excluded << " no)" << std::endl;
 }
 
-void
-TilePairings::next()
+size_t
+TilePairings::propagate(const PairingQueue::Candidate& candidate, bool include)
 {
-  m_current_match++;
+  const auto opposite = TileAdjacency::opposite(candidate.dir);
+  const auto& tiles = m_seams.get_class_members(m_seams.get_class(candidate.tile, candidate.dir));
+  const auto& matches = m_seams.get_class_members(m_seams.get_class(candidate.match, opposite));
 
-  if (m_current_match >= g_selected_tiles.size())
+  size_t answered = 0;
+  for (const size_t tile : tiles)
   {
-    m_current_match = 0;
-    m_current_tile++;
-
-    if (m_current_tile >= g_selected_tiles.size())
+    for (const size_t match : matches)
     {
-      m_current_tile = 0;
+      // The queue holds either the pairing or its mirror
+      if (m_queue.contains(tile, candidate.dir, match))
+        m_queue.decide({ tile, candidate.dir, match }, include);
+      else if (m_queue.contains(match, opposite, tile))
+        m_queue.decide({ match, opposite, tile }, include);
+      else
+        continue;
 
-      if (++m_match_direction > 3)
-      {
-        log_warn << "Done" << std::endl;
-        return;
-      }
+      g_session.record_decision(tile, candidate.dir, match, include);
+
+      answered++;
     }
   }
 
-  auto has = [](std::vector<Tile*>& array, Tile* element) {
-    return std::find(array.begin(), array.end(), element) != array.end();
-  };
+  return answered;
+}
 
-  bool skip = false;
-  auto& tile = g_selected_tiles[m_current_tile];
-  auto& match = g_selected_tiles[m_current_match];
-  switch(m_match_direction)
-  {
-    case 0:
-      if (tile.mask_down != match.non_solid + 1)
-      {
-        skip = true;
-        break;
-      }
+void
+TilePairings::answer(bool include)
+{
+  if (m_queue.empty())
+    return;
 
-      if (has(tile.ex_down, &match) || has(tile.in_down, &match))
-        skip = true;
-      break;
+  decide(m_queue.front(), include);
 
-    case 1:
-      if (tile.mask_up != match.non_solid + 1)
-      {
-        skip = true;
-        break;
-      }
+  if (m_queue.empty())
+    log_info << "All pairings decided" << std::endl;
+  next_question();
+}
 
-      if (has(tile.ex_up, &match) || has(tile.in_up, &match))
-        skip = true;
-      break;
+void
+TilePairings::decide(const PairingQueue::Candidate& candidate, bool include)
+{
+  m_queue.decide(candidate, include);
+  g_session.record_decision(candidate.tile, candidate.dir, candidate.match, include);
+  m_propagated += propagate(candidate, include);
+}
 
-    case 2:
-      if (tile.mask_right != match.non_solid + 1)
-      {
-        skip = true;
-        break;
-      }
+void
+TilePairings::next_question()
+{
+  m_btn_yes.set_disabled(m_queue.empty());
+  m_btn_no.set_disabled(m_queue.empty());
 
-      if (has(tile.ex_right, &match) || has(tile.in_right, &match))
-        skip = true;
-      break;
+  if (m_batch_mode)
+    refresh_batch();
+}
+
+void
+TilePairings::refresh_batch()
+{
+  // Pairings that stay in the grid, e.g. when the window was resized,
+  // keep what was clicked on them
+  std::vector<PairingQueue::Candidate> old_batch;
+  std::vector<bool> old_fits;
+  old_batch.swap(m_batch);
+  old_fits.swap(m_batch_fits);
+  m_batch_layer.invalidate();
+
+  if (m_queue.empty())
+    return;
 
-    case 3:
-      if (tile.mask_left != match.non_solid + 1)
+  const Size ws = m_window.get_size();
+  const Size cell = get_cell_size(m_queue.front().dir);
+
+  // Between the text at the top and the buttons at the bottom
+  const float width = ws.w - BATCH_PADDING;
+  const float height = ws.h - 64.f - 32.f - BATCH_PADDING;
+  m_batch_columns = std::max(1, static_cast<int>(width / (cell.w + BATCH_PADDING)));
+  const int rows = std::max(1, static_cast<int>(height / (cell.h + BATCH_PADDING)));
+
+  m_batch = m_queue.get_batch(m_batch_columns * rows);
+  m_batch_fits.assign(m_batch.size(), false);
+  for (size_t i = 0; i < m_batch.size(); ++i)
+  {
+    for (size_t j = 0; j < old_batch.size(); ++j)
+    {
+      if (m_batch[i].tile == old_batch[j].tile && m_batch[i].dir == old_batch[j].dir &&
+          m_batch[i].match == old_batch[j].match)
       {
-        skip = true;
+        m_batch_fits[i] = old_fits[j];
         break;
       }
+    }
+  }
+}
 
-      if (has(tile.ex_left, &match) || has(tile.in_left, &match))
-        skip = true;
-      break;
+void
+TilePairings::commit_batch(bool reject_all)
+{
+  // What was clicked goes in before anything is propagated, so that
+  // propagation only fills in the pairings that were left alone.
+  std::vector<size_t> marked;
+  for (size_t i = 0; i < m_batch.size(); ++i)
+  {
+    const auto& candidate = m_batch[i];
+    if ((reject_all || m_batch_fits[i]) && m_queue.contains(candidate.tile, candidate.dir, candidate.match))
+    {
+      m_queue.decide(candidate, !reject_all);
+      g_session.record_decision(candidate.tile, candidate.dir, candidate.match, !reject_all);
+      marked.push_back(i);
+    }
+  }
+
+  for (const size_t i : marked)
+    m_propagated += propagate(m_batch[i], !reject_all);
 
+  // The rest don't fit, unless propagation answered them already
+  for (const auto& candidate : m_batch)
+  {
+    if (m_queue.contains(candidate.tile, candidate.dir, candidate.match))
+      decide(candidate, false);
   }
 
-  if (skip)
-    next();
+  if (m_queue.empty())
+    log_info << "All pairings decided" << std::endl;
+  next_question();
+}
+
+Size
+TilePairings::get_cell_size(TileAdjacency::Direction dir)
+{
+  if (dir == TileAdjacency::UP || dir == TileAdjacency::DOWN)
+    return Size(32.f, 64.f);
+  return Size(64.f, 32.f);
+}
+
+Rect
+TilePairings::get_cell_rect(size_t index) const
+{
+  const Size cell = get_cell_size(m_batch[index].dir);
+  const float column = static_cast<float>(index % m_batch_columns);
+  const float row = static_cast<float>(index / m_batch_columns);
+  return Rect(Vector(BATCH_PADDING + column * (cell.w + BATCH_PADDING),
+                     64.f + BATCH_PADDING + row * (cell.h + BATCH_PADDING)), cell);
 }
 
 void
 TilePairings::resize_elements()
 {
-  m_btn_yes.get_rect() = Rect(0.f, m_window.get_size().h - 32.f, m_window.get_size().w / 4.f, m_window.get_size().h);
-  m_btn_no.get_rect() = Rect(m_window.get_size().w / 4.f, m_window.get_size().h - 32.f, m_window.get_size().w / 2.f, m_window.get_size().h);
-  m_btn_prev.get_rect() = Rect(m_window.get_size().w / 2.f, m_window.get_size().h - 32.f, m_window.get_size().w * 3.f / 4.f, m_window.get_size().h);
-  m_btn_next.get_rect() = Rect(m_window.get_size().w * 3.f / 4.f, m_window.get_size().h - 32.f, m_window.get_size().w, m_window.get_size().h);
+  m_btn_yes.get_rect() = Rect(0.f, m_window.get_size().h - 32.f, m_window.get_size().w / 5.f, m_window.get_size().h);
+  m_btn_no.get_rect() = Rect(m_window.get_size().w / 5.f, m_window.get_size().h - 32.f, m_window.get_size().w * 2.f / 5.f, m_window.get_size().h);
+  m_btn_batch.get_rect() = Rect(m_window.get_size().w * 2.f / 5.f, m_window.get_size().h - 32.f, m_window.get_size().w * 3.f / 5.f, m_window.get_size().h);
+  m_btn_prev.get_rect() = Rect(m_window.get_size().w * 3.f / 5.f, m_window.get_size().h - 32.f, m_window.get_size().w * 4.f / 5.f, m_window.get_size().h);
+  m_btn_next.get_rect() = Rect(m_window.get_size().w * 4.f / 5.f, m_window.get_size().h - 32.f, m_window.get_size().w, m_window.get_size().h);
 }
@@ -22,8 +22,13 @@
 #include <vector>
 
 #include "ui/button_label.hpp"
+#include "util/rect.hpp"
 
+#include "control_layer.hpp"
+#include "pairing_queue.hpp"
+#include "seam_scorer.hpp"
 #include "tile.hpp"
+#include "tile_adjacency.hpp"
 
 class TilePairings :
   public Scene
@@ -36,24 +41,59 @@ public:
   virtual void event(const SDL_Event& event) override;
   virtual void update(float dt_sec) override;
   virtual void draw() const override;
+  virtual void tileset_reloaded() override;
 
   void yes();
   void no();
+  /** Switches between one question at a time and a grid of them */
+  void toggle_batch();
 
 private:
-  void next();
+  /** Where the match goes relative to the tile, for a pair 32 pixels apart */
+  static Vector get_offset(TileAdjacency::Direction dir);
+
+  /** Lists the questions again, e.g. after the selection changed */
+  void rebuild_queue();
+  /** Answers the questions whose seams are clearly good or clearly bad */
+  void answer_obvious();
+  void answer(bool include);
+  /** Records an answer, journals it and applies it to identical edges */
+  void decide(const PairingQueue::Candidate& candidate, bool include);
+  /** Updates the controls for whatever question comes up next */
+  void next_question();
+
+  /** Lays out the questions about the current tile and side in a grid */
+  void refresh_batch();
+  /** Answers the whole grid; pairings that weren't picked don't fit,
+      unless a picked one with identical edges says otherwise */
+  void commit_batch(bool reject_all);
+  /** Room for the two tiles of a pair, side by side on dir */
+  static Size get_cell_size(TileAdjacency::Direction dir);
+  Rect get_cell_rect(size_t index) const;
+  /** Gives the same answer to every pairing of tiles whose edges are
+      identical to those of the candidate. Returns how many it answered. */
+  size_t propagate(const PairingQueue::Candidate& candidate, bool include);
 
 private:
   void resize_elements();
 
 private:
-  int m_current_tile;
-  int m_current_match;
-  int m_match_direction;
+  PairingQueue m_queue;
+  SeamScorer m_seams;
+  size_t m_auto_included;
+  size_t m_auto_excluded;
+  size_t m_propagated;
+  bool m_batch_mode;
+  std::vector<PairingQueue::Candidate> m_batch;
+  std::vector<bool> m_batch_fits;
+  size_t m_batch_columns;
+  /** The grid, drawn in one go and kept until it changes */
+  mutable ControlLayer m_batch_layer;
   ButtonLabel m_btn_yes;
   ButtonLabel m_btn_no;
   ButtonLabel m_btn_prev;
   ButtonLabel m_btn_next;
+  ButtonLabel m_btn_batch;
 
 private:
   TilePairings(const TilePairings&) = delete;
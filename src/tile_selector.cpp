@@ -16,6 +16,10 @@
 
 #include "tile_selector.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
 #include "SDL.h"
 #include "portable-file-dialogs.h"
 
@@ -25,8 +29,15 @@
 #include "video/window.hpp"
 
 #include "main.hpp"
+#include "mip_cache.hpp"
 #include "supertux/tile_set_parser.hpp"
+#include "supertux/util/file_system.hpp"
+#include "tile_atlas.hpp"
+#include "tile_id_index.hpp"
+#include "session.hpp"
 #include "tile_mask_selector.hpp"
+#include "tile_pairings.hpp"
+#include "tileset_watcher.hpp"
 
 static const Control::ThemeSet theme_set = ([]{
   Control::Theme t;
@@ -102,13 +113,15 @@ TileSelector::TileSelector(Window& window) :
   Scene(window),
   m_mouse_pos(),
   m_current_tile(-1),
+  m_selection_start(-1),
+  m_selection_anchor(-1),
   m_tilegroups_list(30.f, list_scrollbar_theme_set, 100, Rect(), list_theme_set, nullptr),
   m_tiles_scrollbar(nullptr, window.get_size().h - 32.f, 0.f, false, 0xff, 100, Rect(),
                     scrollbar_theme_set, nullptr),
   m_btn_add_tileset("Open tileset", [this](int){ add_tileset(); }, 0xff, true, 100, Rect(), theme_set, nullptr),
   m_btn_next_step("Next step", [this](int)
     {
-      if (!g_tilegroup || g_selected_tiles.empty())
+      if (g_selected_tiles.empty())
       {
         SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, "Error", "Some tiles must exist for autotiles to be created", nullptr);
         return;
@@ -118,26 +131,47 @@ TileSelector::TileSelector(Window& window) :
     0xff, true, 100, Rect(), theme_set, nullptr),
   m_dragging(false),
   m_camera(0.f, 0.f),
-  m_last_folder()
+  m_zoom(1.f),
+  m_last_folder(),
+  m_controls(),
+  m_pages(),
+  m_sidebar(),
+  m_sidebar_progress(0.f),
+  m_sidebar_revision(0)
 {
-  for (TileGroup& tilegroup : g_tilegroups)
-    m_tilegroups_list.add_item(tilegroup.filename, &tilegroup);
+  refresh_tilegroups_list();
 
   m_tilegroups_list.set_on_changed([this](int, TileGroup* const* tilegroup)
     {
       if (!tilegroup) return;
 
+      // The selection may span several groups
       g_tilegroup = *tilegroup;
-      g_selected_tiles.clear();
+
+      // Decode the sheet now rather than on the first frame that shows it
+      if (!m_pages || m_pages->get_identity() != g_tilegroup->texture.get_identity())
+        m_pages = std::make_unique<PagedTexture>(g_tilegroup->texture.get_identity());
+      m_pages->load();
       m_current_tile = g_tilegroup->tiles.size() - 1;
+      m_selection_start = -1;
+      m_selection_anchor = -1;
     });
 
   resize_elements();
+  g_session.save("selection");
 }
 
 void
 TileSelector::event(const SDL_Event& event)
 {
+  // Any input may change what is hovered or pressed
+  invalidate();
+
+  // The controls only need to be drawn again if they could react
+  if (event.type != SDL_MOUSEMOTION || is_over_controls(m_mouse_pos) ||
+      is_over_controls(Vector(event.motion.x, event.motion.y)))
+    m_controls.invalidate();
+
   if (m_tilegroups_list.event(event) || (m_tiles_scrollbar.is_valid() && m_tiles_scrollbar.event(event))
       || m_btn_add_tileset.event(event) || m_btn_next_step.event(event))
     return;
@@ -158,14 +192,17 @@ TileSelector::event(const SDL_Event& event)
       if (g_tilegroup)
       {
         auto ws = (m_window.get_size().vector() - Vector(32 - m_window.get_size().w / 4, 32)).size();
-        auto& t = *g_tilegroup->texture;
-        auto s = g_tilegroup->region.size();
-        const Rect trect = Rect(s).move(Vector(ws) / 2 - Vector(s) / 2).move(m_camera);
+        const Rect trect = get_tiles_rect();
         if (trect.clipped(Rect(0.f, 0.f, ws.w - (m_tiles_scrollbar.is_valid() ? 37.f : 32.f), ws.h - 32.f)).contains(m_mouse_pos))
         {
-          const Vector tile_pos = ((m_mouse_pos - trect.top_lft()) / 32.f).floor();
-          m_current_tile = static_cast<int>(tile_pos.y) * static_cast<int>(s.w / 32.f) +
-                           static_cast<int>(tile_pos.x);
+          const Vector tile_pos = ((m_mouse_pos - trect.top_lft()) / get_tile_size()).floor();
+          const int width = static_cast<int>(g_tilegroup->width);
+          const int tile = static_cast<int>(tile_pos.y) * width + static_cast<int>(tile_pos.x);
+
+          // Rounding at the far edges may land one past the last tile
+          if (tile_pos.x >= 0.f && tile_pos.x < width && tile >= 0 &&
+              tile < static_cast<int>(g_tilegroup->tiles.size()))
+            m_current_tile = tile;
         }
       }
     }
@@ -177,6 +214,12 @@ TileSelector::event(const SDL_Event& event)
       {
         m_dragging = true;
       }
+      else if (event.button.button == SDL_BUTTON_LEFT && g_tilegroup && m_current_tile >= 0 &&
+               get_tiles_rect().contains(m_mouse_pos) &&
+               Rect(0.f, 0.f, m_window.get_size().w - (m_tiles_scrollbar.is_valid() ? 37.f : 32.f), m_window.get_size().h - 32.f).contains(m_mouse_pos))
+      {
+        m_selection_start = m_current_tile;
+      }
       break;
 
     case SDL_MOUSEBUTTONUP:
@@ -184,22 +227,18 @@ TileSelector::event(const SDL_Event& event)
       {
         case SDL_BUTTON_LEFT:
         {
-          if (!g_tilegroup || m_current_tile < 0 || !g_tilegroup->tiles[m_current_tile].id)
+          // Releasing outside the group spans up to the last tile hovered
+          const int start = m_selection_start;
+          m_selection_start = -1;
+          if (!g_tilegroup || start < 0 || m_current_tile < 0)
             return;
 
-          auto ws = (m_window.get_size().vector() - Vector(32 - m_window.get_size().w / 4, 32)).size();
-          auto& t = *g_tilegroup->texture;
-          auto s = g_tilegroup->region.size();
-          const Rect trect = Rect(s).move(Vector(ws) / 2 - Vector(s) / 2).move(m_camera);
-          if (trect.contains(m_mouse_pos))
-          {
-            for (const auto& t : g_selected_tiles)
-              if (t.id == g_tilegroup->tiles[m_current_tile].id)
-                return;
+          if ((SDL_GetModState() & KMOD_SHIFT) && m_selection_anchor >= 0)
+            select_tiles(m_selection_anchor, m_current_tile, false);
+          else
+            select_tiles(start, m_current_tile, true);
 
-            g_selected_tiles.push_back(g_tilegroup->tiles[m_current_tile]);
-            m_tiles_scrollbar.set_total(g_selected_tiles.size() * 32.f);
-          }
+          m_selection_anchor = m_current_tile;
         }
         break;
 
@@ -214,8 +253,9 @@ TileSelector::event(const SDL_Event& event)
             int tilenum = static_cast<int>(m_mouse_pos.y + m_tiles_scrollbar.get_progress()) / 32;
             if (g_selected_tiles.size() > tilenum)
             {
-              g_selected_tiles.erase(g_selected_tiles.begin() + tilenum);
+              g_selected_tiles.erase(tilenum);
               m_tiles_scrollbar.set_total(g_selected_tiles.size() * 32.f);
+              g_session.save("selection");
             }
           }
         }
@@ -226,6 +266,14 @@ TileSelector::event(const SDL_Event& event)
       }
       break;
 
+    case SDL_KEYDOWN:
+      if (event.key.keysym.sym == SDLK_a && (event.key.keysym.mod & KMOD_CTRL) && g_tilegroup &&
+          !g_tilegroup->tiles.empty())
+      {
+        select_tiles(0, static_cast<int>(g_tilegroup->tiles.size()) - 1, false);
+      }
+      break;
+
     case SDL_WINDOWEVENT_RESIZED:
       resize_elements();
       break;
@@ -233,6 +281,9 @@ TileSelector::event(const SDL_Event& event)
     case SDL_MOUSEWHEEL:
       if (m_mouse_pos.x >= m_window.get_size().w - 37.f)
         m_tiles_scrollbar.set_progress(m_tiles_scrollbar.get_progress() - event.wheel.y * 8.f);
+      else if (g_tilegroup && event.wheel.y != 0 &&
+               Rect(0.f, 0.f, m_window.get_size().w - (m_tiles_scrollbar.is_valid() ? 37.f : 32.f), m_window.get_size().h - 32.f).contains(m_mouse_pos))
+        zoom(event.wheel.y > 0 ? 1 : -1, m_mouse_pos);
       break;
 
     default:
@@ -250,53 +301,113 @@ TileSelector::draw() const
 {
   Renderer& r = m_window.get_renderer();
 
-  auto ctrls = m_window.create_texture(m_window.get_size());
-  DrawingContext dc(r);
-  m_tilegroups_list.draw(dc);
-  if (m_tiles_scrollbar.is_valid())
-    m_tiles_scrollbar.draw(dc);
-  m_btn_next_step.draw(dc);
-  m_btn_add_tileset.draw(dc);
-  dc.render(ctrls.get());
+  Texture& ctrls = m_controls.get(m_window, [this](DrawingContext& dc) {
+    m_tilegroups_list.draw(dc);
+    if (m_tiles_scrollbar.is_valid())
+      m_tiles_scrollbar.draw(dc);
+    m_btn_next_step.draw(dc);
+    m_btn_add_tileset.draw(dc);
+  });
+
+  auto ws = (m_window.get_size().vector() - Vector(32, 32)).size();
+
+  // The selected tiles bar only draws the entries in view, into a strip
+  // that is kept until the selection or the scrolling changes. Like the
+  // controls, it renders on its own, before the frame starts.
+  const Size strip_size(32.f, ws.h + 32.f);
+  const Texture* strip = nullptr;
+  if (g_tilegroup)
+  {
+    g_tile_atlas.update();
+    const float progress = m_tiles_scrollbar.get_progress();
+    if (progress != m_sidebar_progress || g_tile_atlas.get_revision() != m_sidebar_revision)
+    {
+      m_sidebar_progress = progress;
+      m_sidebar_revision = g_tile_atlas.get_revision();
+      m_sidebar.invalidate();
+    }
+
+    const size_t first = static_cast<size_t>(std::max(0.f, progress) / 32.f);
+    const size_t last = std::min(g_selected_tiles.size(),
+                                 static_cast<size_t>((progress + strip_size.h) / 32.f) + 1);
+    strip = &m_sidebar.get(m_window, strip_size, [&](DrawingContext& dc) {
+      for (size_t i = first; i < last; ++i)
+      {
+        const Rect tile_rect(0.f, static_cast<float>(i) * 32.f - progress,
+                             32.f, static_cast<float>(i + 1) * 32.f - progress);
+        const auto tile = g_tile_atlas.get(m_window, i);
+        dc.draw_texture(*tile.texture, tile.srcrect, tile_rect, 0.f, Color(1.f, 1.f, 1.f), Renderer::Blend::BLEND, 1);
+      }
+    });
+  }
 
   r.start_draw();
 
-  auto ws = (m_window.get_size().vector() - Vector(32, 32)).size();
   r.draw_filled_rect(ws, Color(.15f, .15f, .15f), Renderer::Blend::NONE);
 
   if (g_tilegroup)
   {
-    auto ws_tiles = m_window.get_size().vector() - Vector(32 - m_window.get_size().w / 4, 32);
-    auto& t = *g_tilegroup->texture;
-    auto s = g_tilegroup->region.size();
+    if (!m_pages || m_pages->get_identity() != g_tilegroup->texture.get_identity())
+      m_pages = std::make_unique<PagedTexture>(g_tilegroup->texture.get_identity());
 
-    const Rect trect = Rect(s).move(ws_tiles / 2 - Vector(s) / 2).move(m_camera);
+    const Rect trect = get_tiles_rect();
     r.draw_filled_rect(trect, Color(0.f, 0.f, 0.f), Renderer::Blend::NONE);
 
-    // Main tiles texture
-    r.draw_texture(t, g_tilegroup->region, trect, 0.f, Color(1.f, 1.f, 1.f), Renderer::Blend::BLEND);
+    // Main tiles texture. Zoomed out, it is drawn from the mip level
+    // that matches the zoom, once that level was computed.
+    int level = 0;
+    for (float zoom = m_zoom; zoom <= .5f && level < MipCache::MAX_LEVEL; zoom *= 2.f)
+      level++;
+
+    const auto draw_page = [&r](const Texture& page, const Rect& src, const Rect& dst) {
+      r.draw_texture(page, src, dst, 0.f, Color(1.f, 1.f, 1.f), Renderer::Blend::BLEND);
+    };
+    PagedTexture* mip = level > 0 ? g_mip_cache.get(g_tilegroup->texture.get_identity(), level) : nullptr;
+    if (mip)
+    {
+      const float scale = 1.f / static_cast<float>(1 << level);
+      const Rect& region = g_tilegroup->region;
+      const Rect src(region.x1 * scale, region.y1 * scale, region.x2 * scale, region.y2 * scale);
+      mip->draw(m_window, src, trect, Rect(ws), draw_page);
+    }
+    else
+    {
+      m_pages->draw(m_window, g_tilegroup->region, trect, Rect(ws), draw_page);
+    }
 
     // Tile hover
-    if (g_tilegroup->tiles[m_current_tile].id &&
+    const float tile_size = get_tile_size();
+    if (m_current_tile >= 0 && g_tilegroup->tiles.get_ids()[m_current_tile] &&
         trect.clipped(Rect(0.f, 0.f, ws.w - (m_tiles_scrollbar.is_valid() ? 37.f : 32.f), ws.h - 32.f)).contains(m_mouse_pos))
     {
-      Vector tl = ((m_mouse_pos - trect.top_lft()) / 32.f).floor() * 32.f + trect.top_lft();
-      r.draw_filled_rect(Rect(tl, Size(32.f, 32.f)), Color(1.f, 1.f, 1.f, .25f), Renderer::Blend::BLEND);
+      Vector tl = ((m_mouse_pos - trect.top_lft()) / tile_size).floor() * tile_size + trect.top_lft();
+      r.draw_filled_rect(Rect(tl, Size(tile_size, tile_size)), Color(1.f, 1.f, 1.f, .25f), Renderer::Blend::BLEND);
+    }
+
+    // Marquee
+    if (m_selection_start >= 0 && m_selection_start != m_current_tile && g_tilegroup->width > 0)
+    {
+      const int width = static_cast<int>(g_tilegroup->width);
+      const Vector start(m_selection_start % width, m_selection_start / width);
+      const Vector end(m_current_tile % width, m_current_tile / width);
+      const Vector tl(std::min(start.x, end.x), std::min(start.y, end.y));
+      const Vector br(std::max(start.x, end.x) + 1.f, std::max(start.y, end.y) + 1.f);
+      r.draw_filled_rect(Rect(tl * tile_size + trect.top_lft(), ((br - tl) * tile_size).size()),
+                         Color(.4f, .6f, 1.f, .3f), Renderer::Blend::BLEND);
     }
 
     // Selected tiles bar
     r.draw_filled_rect(Rect(0.f, ws.h, ws.w, ws.h + 32.f), Color(.2f, .2f, .2f), Renderer::Blend::NONE);
     r.draw_filled_rect(Rect(ws.w, 0.f, ws.w + 32.f, ws.h + 32.f), Color(.2f, .2f, .2f), Renderer::Blend::NONE);
 
-    Rect tile_rect(ws.w, 0.f - m_tiles_scrollbar.get_progress(), ws.w + 32.f, 32.f - m_tiles_scrollbar.get_progress());
-    for (const auto& t : g_selected_tiles)
-    {
-      r.draw_texture(*g_tilegroup->texture, t.srcrect, tile_rect, 0.f, Color(1.f, 1.f, 1.f), Renderer::Blend::BLEND);
-      tile_rect.move(Vector(0, 32));
-    }
+    r.draw_texture(*strip, Rect(strip_size), Rect(Vector(ws.w, 0.f), strip_size), 0.f, Color(1.f, 1.f, 1.f), Renderer::Blend::BLEND);
+
+    // Pages that went out of view since the last frame aren't needed
+    m_pages->release_unused();
+    g_mip_cache.release_unused();
   }
 
-  r.draw_texture(*ctrls, m_window.get_size(), m_window.get_size(), 0.f, Color(1.f, 1.f, 1.f), Renderer::Blend::BLEND);
+  r.draw_texture(ctrls, m_window.get_size(), m_window.get_size(), 0.f, Color(1.f, 1.f, 1.f), Renderer::Blend::BLEND);
 
   r.end_draw();
 }
@@ -309,13 +420,21 @@ TileSelector::add_tileset()
     return;
 
 
+  m_last_folder = FileSystem::dirname(files[0]);
+
+  g_tileset_watcher.stop();
+  g_session.close();
   g_selected_tiles.clear();
+  g_tile_atlas.clear();
   g_tilegroups.clear();
+  g_tile_index.clear();
   g_tilegroup = nullptr;
   m_tilegroups_list.clear_items();
 
-  TileSetParser parser(g_tilegroups, m_last_folder, m_window);
+  TileSetParser parser(g_tilegroups, files[0]);
+  parser.set_index(&g_tile_index);
   parser.parse();
+  g_tileset_watcher.watch(files[0]);
 
   if (g_tilegroups.empty())
   {
@@ -324,10 +443,120 @@ TileSelector::add_tileset()
     return;
   }
 
-  for (TileGroup& tilegroup : g_tilegroups)
-    m_tilegroups_list.add_item(tilegroup.filename, &tilegroup);
+  refresh_tilegroups_list();
 
   m_camera = Vector();
+
+  // Pick up where the last session on this tileset left off
+  const std::string step = g_session.open(files[0]);
+  m_tiles_scrollbar.set_total(g_selected_tiles.size() * 32.f);
+  if (g_selected_tiles.empty())
+    return;
+
+  if (step == "masks")
+    change_scene(std::make_unique<TileMaskSelector>(m_window));
+  else if (step == "pairings")
+    change_scene(std::make_unique<TilePairings>(m_window));
+}
+
+void
+TileSelector::tileset_reloaded()
+{
+  refresh_tilegroups_list();
+  m_tiles_scrollbar.set_total(g_selected_tiles.size() * 32.f);
+  m_controls.invalidate();
+  m_sidebar.invalidate();
+
+  if (!g_tilegroup || m_current_tile >= static_cast<int>(g_tilegroup->tiles.size()))
+    m_current_tile = g_tilegroup ? static_cast<int>(g_tilegroup->tiles.size()) - 1 : -1;
+}
+
+bool
+TileSelector::is_over_controls(const Vector& pos)
+{
+  return m_tilegroups_list.get_rect().contains(pos) ||
+         (m_tiles_scrollbar.is_valid() && m_tiles_scrollbar.get_rect().contains(pos)) ||
+         m_btn_add_tileset.get_rect().contains(pos) ||
+         m_btn_next_step.get_rect().contains(pos);
+}
+
+Rect
+TileSelector::get_tiles_rect() const
+{
+  auto ws = m_window.get_size().vector() - Vector(32 - m_window.get_size().w / 4, 32);
+  auto s = g_tilegroup->region.size() * m_zoom;
+  return Rect(s).move(ws / 2 - Vector(s) / 2).move(m_camera);
+}
+
+void
+TileSelector::zoom(int steps, const Vector& pos)
+{
+  const float old_zoom = m_zoom;
+  m_zoom = std::max(1.f / 8.f, std::min(4.f, m_zoom * std::pow(2.f, static_cast<float>(steps))));
+  if (m_zoom == old_zoom)
+    return;
+
+  // The group is centered, so the offset of pos from the group's
+  // top left corner scales with the zoom while the camera makes up
+  // the difference.
+  const auto ws = m_window.get_size().vector() - Vector(32 - m_window.get_size().w / 4, 32);
+  const Vector size = g_tilegroup->region.size().vector();
+  const Vector offset = pos - ws / 2 + size * (old_zoom / 2.f) - m_camera;
+  m_camera = pos - ws / 2 + size * (m_zoom / 2.f) - offset * (m_zoom / old_zoom);
+}
+
+bool
+TileSelector::is_animating() const
+{
+  // Keep drawing until the mipmaps for the zoomed out view are in
+  return g_tilegroup && m_zoom < 1.f && g_mip_cache.is_building();
+}
+
+void
+TileSelector::select_tiles(int from, int to, bool rectangle)
+{
+  const int count = static_cast<int>(g_tilegroup->tiles.size());
+  const int width = static_cast<int>(g_tilegroup->width);
+  if (width == 0 || from < 0 || to < 0 || from >= count || to >= count)
+    return;
+
+  const auto group = static_cast<uint16_t>(g_tilegroup - g_tilegroups.data());
+  std::vector<TileHandle> handles;
+
+  if (rectangle)
+  {
+    const int left = std::min(from % width, to % width);
+    const int right = std::max(from % width, to % width);
+    const int top = std::min(from / width, to / width);
+    const int bottom = std::max(from / width, to / width);
+
+    handles.reserve((right - left + 1) * (bottom - top + 1));
+    for (int y = top; y <= bottom; ++y)
+      for (int x = left; x <= right; ++x)
+        handles.push_back({ group, 0, static_cast<uint32_t>(y * width + x) });
+  }
+  else
+  {
+    handles.reserve(std::abs(to - from) + 1);
+    for (int i = std::min(from, to); i <= std::max(from, to); ++i)
+      handles.push_back({ group, 0, static_cast<uint32_t>(i) });
+  }
+
+  // Empty and already selected tiles are skipped by the selection itself
+  if (g_selected_tiles.add(handles) > 0)
+  {
+    m_tiles_scrollbar.set_total(g_selected_tiles.size() * 32.f);
+    g_session.save("selection");
+  }
+}
+
+void
+TileSelector::refresh_tilegroups_list()
+{
+  m_controls.invalidate();
+  m_tilegroups_list.clear_items();
+  for (TileGroup& tilegroup : g_tilegroups)
+    m_tilegroups_list.add_item(tilegroup.filename, &tilegroup);
 }
 
 void
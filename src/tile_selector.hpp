@@ -27,6 +27,8 @@
 #include "util/vector.hpp"
 #include "video/texture.hpp"
 
+#include "control_layer.hpp"
+#include "paged_texture.hpp"
 #include "tile.hpp"
 
 class TileSelector :
@@ -40,15 +42,35 @@ public:
   virtual void event(const SDL_Event& event) override;
   virtual void update(float dt_sec) override;
   virtual void draw() const override;
+  virtual void tileset_reloaded() override;
+  virtual bool is_animating() const override;
 
   void add_tileset();
 
 private:
   void resize_elements();
+  void refresh_tilegroups_list();
+
+  /** Whether a position is over one of the controls */
+  bool is_over_controls(const Vector& pos);
+
+  /** Where the current group is drawn */
+  Rect get_tiles_rect() const;
+  /** On-screen size of a tile at the current zoom */
+  float get_tile_size() const { return 32.f * m_zoom; }
+  /** Changes the zoom by a power of two, keeping the point under pos still */
+  void zoom(int steps, const Vector& pos);
+  /** Selects every tile in the rectangle spanned by two tiles, or,
+      if rectangle is false, every tile between them in reading order. */
+  void select_tiles(int from, int to, bool rectangle);
 
 private:
   Vector m_mouse_pos;
   int m_current_tile;
+  /** Tile the left button went down on, or -1 */
+  int m_selection_start;
+  /** Last tile clicked, from which shift-clicks extend */
+  int m_selection_anchor;
 
   Listbox<TileGroup*> m_tilegroups_list;
   Scrollbar m_tiles_scrollbar;
@@ -57,8 +79,19 @@ private:
 
   bool m_dragging;
   Vector m_camera;
+  float m_zoom;
   std::string m_last_folder;
 
+  mutable ControlLayer m_controls;
+
+  /** The current group's sheet, uploaded only where it is in view */
+  mutable std::unique_ptr<PagedTexture> m_pages;
+
+  /** The visible part of the selected tiles bar, and what it showed */
+  mutable ControlLayer m_sidebar;
+  mutable float m_sidebar_progress;
+  mutable uint64_t m_sidebar_revision;
+
 private:
   TileSelector(const TileSelector&) = delete;
   TileSelector& operator=(const TileSelector&) = delete;
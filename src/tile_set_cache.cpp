@@ -0,0 +1,295 @@
+//  SuperTux Tile Manager - A utility for SuperTux to manage tiles
+//  Copyright (C) 2021 Semphris <semphris@protonmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "tile_set_cache.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+
+#include "util/log.hpp"
+
+#include "mapped_file.hpp"
+#include "supertux/util/file_system.hpp"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Layout, all integers in native byte order, every record 4-byte aligned:
+//
+//   char[8]  magic
+//   u32      version, u32 endianness marker
+//   u64      hash of the .strf contents
+//   u32      image count
+//     u32 length, char[length] path (padded), i64 mtime
+//   u32      group count
+//     u64 block hash, u32 image index, u32 width, u32 height, f32 x1 y1 x2 y2,
+//     u32 id count, u32[id count] ids
+const char MAGIC[8] = { 'S', 'T', 'T', 'M', 'S', 'C', 'A', 'R' };
+const uint32_t VERSION = 2;
+const uint32_t ENDIAN_MARKER = 0x01020304;
+
+int64_t get_mtime(const std::string& path)
+{
+  std::error_code ec;
+  auto time = fs::last_write_time(path, ec);
+  return ec ? -1 : static_cast<int64_t>(time.time_since_epoch().count());
+}
+
+class BinaryReader final
+{
+public:
+  BinaryReader(const char* data, size_t size) :
+    m_pos(data),
+    m_end(data + size)
+  {}
+
+  template<typename T>
+  T read()
+  {
+    T value;
+    read_bytes(&value, sizeof(T));
+    return value;
+  }
+
+  /** Reads an element count, checking that the remaining bytes can hold
+      that many elements of at least element_size bytes each, so that a
+      corrupt count never sizes a container */
+  size_t read_count(size_t element_size)
+  {
+    const uint32_t count = read<uint32_t>();
+    if (static_cast<size_t>(m_end - m_pos) / element_size < count)
+      throw std::runtime_error("truncated");
+    return count;
+  }
+
+  std::string read_string()
+  {
+    const uint32_t length = read<uint32_t>();
+    check(length);
+    std::string str(m_pos, length);
+    m_pos += (length + 3) & ~3u;
+    if (m_pos > m_end)
+      throw std::runtime_error("truncated");
+    return str;
+  }
+
+  void read_bytes(void* out, size_t size)
+  {
+    check(size);
+    std::memcpy(out, m_pos, size);
+    m_pos += size;
+  }
+
+private:
+  void check(size_t size) const
+  {
+    if (static_cast<size_t>(m_end - m_pos) < size)
+      throw std::runtime_error("truncated");
+  }
+
+private:
+  const char* m_pos;
+  const char* m_end;
+};
+
+class BinaryWriter final
+{
+public:
+  BinaryWriter(std::ostream& out) :
+    m_out(out)
+  {}
+
+  template<typename T>
+  void write(const T& value)
+  {
+    m_out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+  }
+
+  void write_string(const std::string& str)
+  {
+    static const char padding[3] = { 0, 0, 0 };
+    write(static_cast<uint32_t>(str.size()));
+    m_out.write(str.data(), str.size());
+    m_out.write(padding, (4 - str.size() % 4) % 4);
+  }
+
+  void write_bytes(const void* data, size_t size)
+  {
+    m_out.write(static_cast<const char*>(data), size);
+  }
+
+private:
+  std::ostream& m_out;
+};
+
+} // namespace
+
+std::string
+TileSetCache::get_filename(const std::string& tileset)
+{
+  return tileset + ".cache";
+}
+
+uint64_t
+TileSetCache::hash(std::string_view data, uint64_t seed)
+{
+  uint64_t hash = seed;
+  for (unsigned char c : data)
+  {
+    hash ^= c;
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+bool
+TileSetCache::load(const std::string& tileset, uint64_t hash,
+                   std::vector<Group>& groups)
+{
+  const std::string filename = get_filename(tileset);
+  if (!fs::exists(filename))
+    return false;
+
+  try
+  {
+    MappedFile file(filename);
+    BinaryReader in(file.data(), file.size());
+
+    char magic[sizeof(MAGIC)];
+    in.read_bytes(magic, sizeof(magic));
+    if (std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        in.read<uint32_t>() != VERSION ||
+        in.read<uint32_t>() != ENDIAN_MARKER ||
+        in.read<uint64_t>() != hash)
+      return false;
+
+    const std::string tiles_path = FileSystem::dirname(tileset);
+
+    // Path length and mtime
+    std::vector<std::string> images(in.read_count(sizeof(uint32_t) + sizeof(int64_t)));
+    for (auto& image : images)
+    {
+      image = in.read_string();
+      if (in.read<int64_t>() != get_mtime(FileSystem::join(tiles_path, image)))
+        return false;
+    }
+
+    // Hash, image index, size, region and id count
+    std::vector<Group> result(in.read_count(sizeof(uint64_t) + 4 * sizeof(uint32_t) + 4 * sizeof(float)));
+    for (auto& group : result)
+    {
+      group.hash = in.read<uint64_t>();
+      const uint32_t image = in.read<uint32_t>();
+      if (image >= images.size())
+        return false;
+
+      group.file = images[image];
+      group.width = in.read<uint32_t>();
+      group.height = in.read<uint32_t>();
+      group.region.x1 = in.read<float>();
+      group.region.y1 = in.read<float>();
+      group.region.x2 = in.read<float>();
+      group.region.y2 = in.read<float>();
+
+      group.ids.resize(in.read_count(sizeof(uint32_t)));
+      in.read_bytes(group.ids.data(), group.ids.size() * sizeof(uint32_t));
+    }
+
+    groups = std::move(result);
+    return true;
+  }
+  catch (const std::exception& err)
+  {
+    log_warn << "Ignoring tileset cache '" << filename << "': " << err.what() << std::endl;
+    return false;
+  }
+}
+
+void
+TileSetCache::save(const std::string& tileset, uint64_t hash,
+                   const std::vector<Group>& groups)
+{
+  const std::string filename = get_filename(tileset);
+  const std::string tmp_filename = filename + ".tmp";
+  const std::string tiles_path = FileSystem::dirname(tileset);
+
+  std::map<std::string, uint32_t> image_indices;
+  std::vector<const std::string*> images;
+  for (const auto& group : groups)
+  {
+    if (image_indices.emplace(group.file, static_cast<uint32_t>(images.size())).second)
+      images.push_back(&group.file);
+  }
+
+  {
+    std::ofstream stream(tmp_filename, std::ios::binary | std::ios::trunc);
+    if (!stream.good())
+    {
+      log_warn << "Couldn't write tileset cache '" << filename << "'" << std::endl;
+      return;
+    }
+
+    BinaryWriter out(stream);
+    out.write_bytes(MAGIC, sizeof(MAGIC));
+    out.write(VERSION);
+    out.write(ENDIAN_MARKER);
+    out.write(hash);
+
+    out.write(static_cast<uint32_t>(images.size()));
+    for (const auto* image : images)
+    {
+      out.write_string(*image);
+      out.write(get_mtime(FileSystem::join(tiles_path, *image)));
+    }
+
+    out.write(static_cast<uint32_t>(groups.size()));
+    for (const auto& group : groups)
+    {
+      out.write(group.hash);
+      out.write(image_indices[group.file]);
+      out.write(static_cast<uint32_t>(group.width));
+      out.write(static_cast<uint32_t>(group.height));
+      out.write(group.region.x1);
+      out.write(group.region.y1);
+      out.write(group.region.x2);
+      out.write(group.region.y2);
+      out.write(static_cast<uint32_t>(group.ids.size()));
+      out.write_bytes(group.ids.data(), group.ids.size() * sizeof(uint32_t));
+    }
+
+    if (!stream.good())
+    {
+      log_warn << "Couldn't write tileset cache '" << filename << "'" << std::endl;
+      stream.close();
+      std::remove(tmp_filename.c_str());
+      return;
+    }
+  }
+
+  // Replace the old sidecar in one step, so readers never see half a file.
+  std::error_code ec;
+  fs::rename(tmp_filename, filename, ec);
+  if (ec)
+  {
+    log_warn << "Couldn't write tileset cache '" << filename << "': " << ec.message() << std::endl;
+    std::remove(tmp_filename.c_str());
+  }
+}
@@ -0,0 +1,62 @@
+//  SuperTux Tile Manager - A utility for SuperTux to manage tiles
+//  Copyright (C) 2021 Semphris <semphris@protonmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _HEADER_STTILEMAN_TILE_SET_CACHE_HPP
+#define _HEADER_STTILEMAN_TILE_SET_CACHE_HPP
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "util/rect.hpp"
+
+/** Binary sidecar written next to a .strf after a successful parse, so
+    that re-opening the tileset can skip the S-expression parse. It is
+    keyed by a hash of the .strf contents and by the modification times
+    of every image it references; if any of those changed, load() fails
+    and the tileset has to be parsed again. */
+class TileSetCache final
+{
+public:
+  /** Everything the parser extracts from one (tiles ...) block */
+  struct Group
+  {
+    uint64_t hash;
+    std::string file;
+    unsigned int width;
+    unsigned int height;
+    Rect region;
+    std::vector<uint32_t> ids;
+  };
+
+public:
+  static std::string get_filename(const std::string& tileset);
+  /** FNV-1a, 64 bit. Pass the previous result as seed to hash data
+      that comes in several pieces. */
+  static uint64_t hash(std::string_view data, uint64_t seed = 0xcbf29ce484222325ull);
+
+  /** Returns false if the sidecar is missing, malformed or stale */
+  static bool load(const std::string& tileset, uint64_t hash,
+                   std::vector<Group>& groups);
+  static void save(const std::string& tileset, uint64_t hash,
+                   const std::vector<Group>& groups);
+
+private:
+  TileSetCache() = delete;
+};
+
+#endif
@@ -0,0 +1,111 @@
+//  SuperTux Tile Manager - A utility for SuperTux to manage tiles
+//  Copyright (C) 2021 Semphris <semphris@protonmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "tileset_validator.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <stdexcept>
+
+#include "parallel.hpp"
+#include "tile.hpp"
+#include "supertux/tile_set_parser.hpp"
+
+TilesetValidator::TilesetValidator(const std::string& folder) :
+  m_folder(folder)
+{
+}
+
+size_t
+TilesetValidator::run(std::ostream& out)
+{
+  const auto start = std::chrono::steady_clock::now();
+
+  std::vector<Report> reports;
+  std::error_code ec;
+  for (auto it = std::filesystem::recursive_directory_iterator(m_folder, ec);
+       !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec))
+  {
+    if (it->is_regular_file(ec) && it->path().extension() == ".strf")
+      reports.push_back({ it->path().string(), {}, 0, 0, 0.0, 0.0 });
+  }
+  if (ec)
+    throw std::runtime_error("Couldn't read folder '" + m_folder + "': " + ec.message());
+
+  std::sort(reports.begin(), reports.end(),
+            [](const Report& a, const Report& b) { return a.filename < b.filename; });
+
+  // One file per worker; the parser runs its own stages inline here.
+  parallel_for(reports.size(), [&](size_t i) { validate(reports[i]); });
+
+  size_t failed = 0;
+  double parse_ms = 0.0;
+  double images_ms = 0.0;
+
+  out << std::fixed << std::setprecision(1);
+  for (const auto& report : reports)
+  {
+    if (report.errors.empty())
+      out << report.filename << ": OK";
+    else
+      out << report.filename << ": " << report.errors.size() << " error(s)";
+
+    out << ", " << report.groups << " groups, " << report.tiles << " tiles, parse "
+        << report.parse_ms << " ms, images " << report.images_ms << " ms" << std::endl;
+
+    for (const auto& error : report.errors)
+      out << "  " << error << std::endl;
+
+    failed += report.errors.empty() ? 0 : 1;
+    parse_ms += report.parse_ms;
+    images_ms += report.images_ms;
+  }
+
+  const double total_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  out << reports.size() << " files, " << failed << " with errors, parse " << parse_ms
+      << " ms, images " << images_ms << " ms, " << total_ms << " ms total on "
+      << get_worker_count() << " threads" << std::endl;
+
+  return failed;
+}
+
+void
+TilesetValidator::validate(Report& report) const
+{
+  std::vector<TileGroup> tilegroups;
+  TileSetParser::Diagnostics diagnostics;
+
+  try
+  {
+    TileSetParser parser(tilegroups, report.filename);
+    parser.set_diagnostics(&diagnostics);
+    parser.parse();
+  }
+  catch (const std::exception& e)
+  {
+    diagnostics.errors.push_back(e.what());
+  }
+
+  report.errors = std::move(diagnostics.errors);
+  report.groups = tilegroups.size();
+  report.tiles = 0;
+  for (const auto& group : tilegroups)
+    report.tiles += group.tiles.size();
+  report.parse_ms = diagnostics.parse_ms;
+  report.images_ms = diagnostics.images_ms;
+}
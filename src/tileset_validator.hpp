@@ -0,0 +1,56 @@
+//  SuperTux Tile Manager - A utility for SuperTux to manage tiles
+//  Copyright (C) 2021 Semphris <semphris@protonmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _HEADER_STTILEMAN_TILESET_VALIDATOR_HPP
+#define _HEADER_STTILEMAN_TILESET_VALIDATOR_HPP
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+/** Parses every .strf file below a folder without opening a window and
+    reports what is wrong with each, along with parse and image timings. */
+class TilesetValidator final
+{
+public:
+  struct Report
+  {
+    std::string filename;
+    std::vector<std::string> errors;
+    size_t groups;
+    size_t tiles;
+    double parse_ms;
+    double images_ms;
+  };
+
+public:
+  TilesetValidator(const std::string& folder);
+
+  /** Returns the number of files with errors */
+  size_t run(std::ostream& out);
+
+private:
+  void validate(Report& report) const;
+
+private:
+  std::string m_folder;
+
+private:
+  TilesetValidator(const TilesetValidator&) = delete;
+  TilesetValidator& operator=(const TilesetValidator&) = delete;
+};
+
+#endif
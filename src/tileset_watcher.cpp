@@ -0,0 +1,152 @@
+//  SuperTux Tile Manager - A utility for SuperTux to manage tiles
+//  Copyright (C) 2021 Semphris <semphris@protonmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "tileset_watcher.hpp"
+
+#include <algorithm>
+
+#include "util/log.hpp"
+
+#include "supertux/tile_set_parser.hpp"
+#include "supertux/util/file_system.hpp"
+#include "tile.hpp"
+#include "tile_atlas.hpp"
+#include "tile_id_index.hpp"
+
+// Editors tend to write a file in several steps; wait for things to
+// settle before reloading.
+static const float RELOAD_DELAY = .25f;
+
+TilesetWatcher g_tileset_watcher;
+
+TilesetWatcher::TilesetWatcher() :
+  m_watcher(),
+  m_filename(),
+  m_pending(false),
+  m_quiet_time(0.f)
+{
+}
+
+void
+TilesetWatcher::watch(const std::string& filename)
+{
+  m_filename = filename;
+  m_pending = false;
+  watch_files();
+}
+
+void
+TilesetWatcher::stop()
+{
+  m_watcher.clear();
+  m_filename.clear();
+  m_pending = false;
+}
+
+bool
+TilesetWatcher::update(float dt_sec)
+{
+  if (m_filename.empty())
+    return false;
+
+  if (!m_watcher.poll().empty())
+  {
+    m_pending = true;
+    m_quiet_time = 0.f;
+    return false;
+  }
+
+  if (!m_pending)
+    return false;
+
+  m_quiet_time += dt_sec;
+  if (m_quiet_time < RELOAD_DELAY)
+    return false;
+
+  m_pending = false;
+  reload();
+  return true;
+}
+
+void
+TilesetWatcher::reload()
+{
+  log_info << "Reloading " << m_filename << std::endl;
+
+  // Remember what the current group was, to find it again afterwards.
+  const bool had_group = g_tilegroup != nullptr;
+  const uint64_t old_hash = had_group ? g_tilegroup->hash : 0;
+  const std::string old_file = had_group ? g_tilegroup->file : std::string();
+  const Vector old_origin = had_group ? g_tilegroup->region.top_lft() : Vector();
+
+  std::vector<TileGroup> previous = std::move(g_tilegroups);
+  g_tilegroups.clear();
+
+  try
+  {
+    TileSetParser parser(g_tilegroups, m_filename);
+    parser.set_index(&g_tile_index);
+    parser.parse(&previous);
+  }
+  catch (const std::exception& err)
+  {
+    // Most likely saved halfway through an edit; keep what we have.
+    log_warn << "Couldn't reload " << m_filename << ": " << err.what() << std::endl;
+    g_tilegroups = std::move(previous);
+    return;
+  }
+
+  g_tilegroup = nullptr;
+  if (had_group)
+  {
+    auto it = std::find_if(g_tilegroups.begin(), g_tilegroups.end(),
+                           [&](const TileGroup& group) { return group.hash == old_hash; });
+    if (it == g_tilegroups.end())
+      it = std::find_if(g_tilegroups.begin(), g_tilegroups.end(), [&](const TileGroup& group) {
+        return group.file == old_file && group.region.top_lft() == old_origin;
+      });
+    if (it != g_tilegroups.end())
+      g_tilegroup = &*it;
+  }
+
+  // Selected tiles keep their masks; only their position may have moved.
+  // Walk backwards so that erasing keeps the remaining indices valid.
+  for (size_t i = g_selected_tiles.size(); i-- > 0;)
+  {
+    const TileHandle* tile = g_tile_index.find(g_selected_tiles[i].id);
+    if (!tile)
+      g_selected_tiles.erase(i);
+    else
+      g_selected_tiles[i].handle = *tile;
+  }
+
+  // The images may have been edited
+  g_tile_atlas.clear();
+
+  previous.clear();
+  watch_files();
+}
+
+void
+TilesetWatcher::watch_files()
+{
+  m_watcher.clear();
+  m_watcher.add(m_filename);
+
+  const std::string tiles_path = FileSystem::dirname(m_filename);
+  for (const auto& group : g_tilegroups)
+    m_watcher.add(FileSystem::join(tiles_path, group.file));
+}
@@ -0,0 +1,58 @@
+//  SuperTux Tile Manager - A utility for SuperTux to manage tiles
+//  Copyright (C) 2021 Semphris <semphris@protonmail.com>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _HEADER_STTILEMAN_TILESET_WATCHER_HPP
+#define _HEADER_STTILEMAN_TILESET_WATCHER_HPP
+
+#include <string>
+
+#include "file_watcher.hpp"
+
+/** Watches the loaded tileset and its images, and reloads g_tilegroups
+    in place once they were edited. Groups whose block and image did not
+    change are kept as they are, along with the selection on them. */
+class TilesetWatcher final
+{
+public:
+  TilesetWatcher();
+
+  /** Starts watching the tileset and every image used by g_tilegroups */
+  void watch(const std::string& filename);
+  void stop();
+
+  /** Returns true if g_tilegroups was reloaded */
+  bool update(float dt_sec);
+
+  bool is_watching() const { return !m_filename.empty(); }
+
+private:
+  void reload();
+  void watch_files();
+
+private:
+  FileWatcher m_watcher;
+  std::string m_filename;
+  bool m_pending;
+  float m_quiet_time;
+
+private:
+  TilesetWatcher(const TilesetWatcher&) = delete;
+  TilesetWatcher& operator=(const TilesetWatcher&) = delete;
+};
+
+extern TilesetWatcher g_tileset_watcher;
+
+#endif